@@ -0,0 +1,93 @@
+#ifndef _ATOMIC_H_
+#define _ATOMIC_H_
+
+#include <stdint.h>
+
+/*
+ * Exclusive accesses, LDREX and STREX, see the ARM Architecture
+ * Reference Manual ARMv7-A, section A3.4, "Synchronization and
+ * semaphores".
+ *
+ * A load-exclusive marks the address in the exclusive monitor,
+ * the store-exclusive that follows succeeds only if nothing else
+ * stored to it in between. An exception may run anything in
+ * between, so the IRQ handler clears the monitor (clrex, see
+ * exception.s) and the interrupted store-exclusive fails, and
+ * is retried. This makes a read-modify-write atomic without
+ * masking the interrupts, and immune to ABA: the store fails
+ * even when the value was changed and changed back.
+ *
+ *    void* old;
+ *    do {
+ *      old = ldrex_ptr(&top);
+ *      elem->next = old;
+ *    } while (strex_ptr(&top, elem));
+ *
+ * On the host, for the tests, there are no interrupts, a
+ * compare-and-swap against the loaded value is enough.
+ */
+#ifdef __arm__
+
+__inline__
+__attribute__((always_inline))
+void* ldrex_ptr(void* volatile* addr) {
+  void* value;
+  __asm__ volatile("ldrex %0, [%1]" : "=r"(value) : "r"(addr) : "memory");
+  return value;
+}
+
+/*
+ * Returns 0 if the store succeeded, 1 if it must be retried.
+ */
+__inline__
+__attribute__((always_inline))
+uint32_t strex_ptr(void* volatile* addr, void* value) {
+  uint32_t failed;
+  __asm__ volatile("strex %0, %2, [%1]" : "=&r"(failed) : "r"(addr), "r"(value) : "memory");
+  return failed;
+}
+
+__inline__
+__attribute__((always_inline))
+uint32_t ldrex_u32(volatile uint32_t* addr) {
+  uint32_t value;
+  __asm__ volatile("ldrex %0, [%1]" : "=r"(value) : "r"(addr) : "memory");
+  return value;
+}
+
+__inline__
+__attribute__((always_inline))
+uint32_t strex_u32(volatile uint32_t* addr, uint32_t value) {
+  uint32_t failed;
+  __asm__ volatile("strex %0, %2, [%1]" : "=&r"(failed) : "r"(addr), "r"(value) : "memory");
+  return failed;
+}
+
+#else
+
+static void* ldrex_value;
+static uint32_t ldrex_u32_value;
+
+static inline void* ldrex_ptr(void* volatile* addr) {
+  ldrex_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+  return ldrex_value;
+}
+
+static inline uint32_t strex_ptr(void* volatile* addr, void* value) {
+  return !__atomic_compare_exchange_n(addr, &ldrex_value, value, 0,
+      __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t ldrex_u32(volatile uint32_t* addr) {
+  ldrex_u32_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+  return ldrex_u32_value;
+}
+
+static inline uint32_t strex_u32(volatile uint32_t* addr, uint32_t value) {
+  return !__atomic_compare_exchange_n(addr, &ldrex_u32_value, value, 0,
+      __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+#endif
+
+#endif /* _ATOMIC_H_ */
@@ -1,6 +1,7 @@
 #include "console.h"
 #include "main.h"
 #include "uart.h"
+#include "prof.h"
 #include <stdint.h>
 
 // cursor position
@@ -10,6 +11,107 @@ static int cursor_col;
 // line callback
 static void (*line_callback)(char*);
 
+/*
+ * The terminal, as far as the console knows, its cursor, on the
+ * screen, and its colors, 0 being the default, and the count of
+ * bytes sent on UART0 when the console last sent something, telling
+ * whether something else was sent since.
+ */
+#define TERM_UNKNOWN 0xff
+
+static struct {
+  int known;
+  int row;
+  int col;
+  uint8_t ink;
+  uint8_t bg;
+  uint32_t sent;
+} term = { .ink = TERM_UNKNOWN, .bg = TERM_UNKNOWN };
+
+static int term_known(void) {
+  if (term.known && term.sent != uart_tx_bytes(UART0)) {
+    term.known = 0;
+    term.ink = term.bg = TERM_UNKNOWN;
+  }
+  return term.known;
+}
+
+static void term_send(const char* s, int len) {
+  term_known();
+  uart_send_buffer(UART0, (const uint8_t*)s, len);
+  term.sent = uart_tx_bytes(UART0);
+}
+
+/*
+ * A relative move, n cells in the given direction, the count being
+ * implied when it is one. Returns its length.
+ */
+static int motion_by(char* s, int n, char dir) {
+  char buf[8];
+  int len = (n == 1) ? ksnprintf(buf, sizeof(buf), "%c[%c", 27, dir)
+                     : ksnprintf(buf, sizeof(buf), "%c[%d%c", 27, n, dir);
+  for (int i = 0; i < len; i++)
+    s[i] = buf[i];
+  return len;
+}
+
+int console_motion(char* s, int from_row, int from_col, int row, int col) {
+  char buf[CONSOLE_MOTION_MAX + 1];
+  char rel[CONSOLE_MOTION_MAX];
+  int len, rlen = 0;
+
+  if (row == from_row && col == from_col)
+    return 0;
+
+  // absolute, the default coordinates being implied
+  if (row == 0 && col == 0)
+    len = ksnprintf(buf, sizeof(buf), "%c[H", 27);
+  else if (col == 0)
+    len = ksnprintf(buf, sizeof(buf), "%c[%dH", 27, row + 1);
+  else
+    len = ksnprintf(buf, sizeof(buf), "%c[%d;%dH", 27, row + 1, col + 1);
+  for (int i = 0; i < len; i++)
+    s[i] = buf[i];
+  if (from_col < 0)
+    return len;
+
+  // the start of the next line, unless the terminal would scroll
+  if (row == from_row + 1 && col == 0 && row < NROWS) {
+    rel[rlen++] = '\r';
+    rel[rlen++] = '\n';
+  } else {
+    // relative, vertically then horizontally
+    if (row < from_row)
+      rlen += motion_by(rel, from_row - row, 'A');
+    else if (row > from_row)
+      rlen += motion_by(rel, row - from_row, 'B');
+    if (col > from_col)
+      rlen += motion_by(rel + rlen, col - from_col, 'C');
+    else if (col == from_col - 1)
+      rel[rlen++] = '\b';
+    else if (col < from_col) {
+      // backward, or a carriage return then forward
+      char left[8], right[8];
+      int llen = motion_by(left, from_col - col, 'D');
+      int flen = (col > 0) ? motion_by(right, col, 'C') : 0;
+      if (1 + flen < llen) {
+        rel[rlen++] = '\r';
+        for (int i = 0; i < flen; i++)
+          rel[rlen++] = right[i];
+      } else {
+        for (int i = 0; i < llen; i++)
+          rel[rlen++] = left[i];
+      }
+    }
+  }
+  if (rlen < len) {
+    for (int i = 0; i < rlen; i++)
+      s[i] = rel[i];
+    len = rlen;
+  }
+  return len;
+}
+
 void cursor_left() {
   if (cursor_col > 0) {
     cursor_col--;
@@ -38,10 +140,31 @@ void cursor_up() {
   }
 }
 
+/*
+ * The terminal keeps its cursor on the screen, the console does
+ * not, its rows go on past the last one.
+ */
+static int screen_row(int row) {
+  return (row < NROWS) ? row : NROWS - 1;
+}
+
+static int screen_col(int col) {
+  return (col < NCOLS) ? col : NCOLS - 1;
+}
+
 void cursor_at(int row, int col) {
+  char s[CONSOLE_MOTION_MAX];
   cursor_row = row;
   cursor_col = col;
-  kprintf("%c[%d;%dH", 27, row + 1, col + 1);
+  row = screen_row(row);
+  col = screen_col(col);
+  int len = term_known() ? console_motion(s, term.row, term.col, row, col)
+                         : console_motion(s, -1, -1, row, col);
+  if (len > 0)
+    term_send(s, len);
+  term.known = 1;
+  term.row = row;
+  term.col = col;
 }
 
 void cursor_position(int* row, int* col) {
@@ -50,28 +173,110 @@ void cursor_position(int* row, int* col) {
 }
 
 void cursor_hide() {
-  kprintf("%c[?25l", 27);
+  char s[8];
+  term_send(s, ksnprintf(s, sizeof(s), "%c[?25l", 27));
 }
 
 void cursor_show() {
-  kprintf("%c[?25h", 27);
+  char s[8];
+  term_send(s, ksnprintf(s, sizeof(s), "%c[?25h", 27));
+}
+
+/*
+ * Set the colors that differ, after a reset if either one goes
+ * back to the default, in a single sequence.
+ */
+void console_colors(uint8_t ink, uint8_t bg) {
+  char s[16];
+  int len = 0;
+
+  term_known();
+  if (ink == term.ink && bg == term.bg)
+    return;
+  if ((ink == COLOR_RESET && term.ink != COLOR_RESET) ||
+      (bg == COLOR_RESET && term.bg != COLOR_RESET)) {
+    len = ksnprintf(s, sizeof(s), "%c[0", 27);
+    term.ink = term.bg = COLOR_RESET;
+  } else {
+    len = ksnprintf(s, sizeof(s), "%c[", 27);
+  }
+  if (ink != term.ink)
+    len += ksnprintf(s + len, sizeof(s) - len, (len > 2) ? ";%d" : "%d", ink);
+  if (bg != term.bg)
+    len += ksnprintf(s + len, sizeof(s) - len, (len > 2) ? ";%d" : "%d", bg);
+  s[len++] = 'm';
+  term_send(s, len);
+  term.ink = ink;
+  term.bg = bg;
 }
 
 void console_color(uint8_t color) {
-  kprintf("%c[%dm", 27, color);
+  char s[8];
+  if (color == COLOR_RESET) {
+    console_colors(COLOR_RESET, COLOR_RESET);
+    return;
+  }
+  term_known();
+  uint8_t* current = (color >= BG_BLACK) ? &term.bg : &term.ink;
+  if (*current == color)
+    return;
+  term_send(s, ksnprintf(s, sizeof(s), "%c[%dm", 27, color));
+  *current = color;
+}
+
+void console_resync(void) {
+  term.known = 1;
+  term.row = screen_row(cursor_row);
+  term.col = screen_col(cursor_col);
+  term.ink = term.bg = COLOR_RESET;
+  term.sent = uart_tx_bytes(UART0);
 }
 
 void console_clear() {
-  kprintf("%c[H%c[2J", 27, 27);
+  char s[8];
+  term_send(s, ksnprintf(s, sizeof(s), "%c[H%c[2J", 27, 27));
   cursor_row = 0;
   cursor_col = 0;
+  term.known = 1;
+  term.row = 0;
+  term.col = 0;
 }
 
 void console_init(void (*callback)(char*)) {
   console_clear();
+  console_colors(COLOR_RESET, COLOR_RESET);
   line_callback = callback;
 }
 
+/*
+ * Send a printable character, or a string, at the cursor, which
+ * moves on, the terminal waiting at the last column to wrap.
+ */
+static void console_print(const char* s, int len) {
+  cursor_at(cursor_row, cursor_col);
+  term_send(s, len);
+  cursor_col += len;
+  if (term.known) {
+    term.col += len;
+    if (term.col >= NCOLS)
+      term.known = 0;
+  }
+}
+
+/*
+ * Send a line feed, with a carriage return, the terminal
+ * translating it or not, and scrolling at the bottom.
+ */
+static void console_newline(const char* s, int len) {
+  term_send(s, len);
+  cursor_row++;
+  cursor_col = 0;
+  if (term.known) {
+    term.row = screen_row(term.row + 1);
+    term.col = 0;
+  }
+}
+
 // line buffer
 #define LINE_LEN 80
 static char line_buffer[LINE_LEN];
@@ -83,20 +288,23 @@ static enum {
   ESCAPE_BRACKET
 } echo_state = NORMAL;
 
+PROF_SCOPE(echo_scope, "console_echo");
+
 void console_echo(uint8_t byte) {
+  prof_begin(&echo_scope);
   switch (echo_state) {
     case NORMAL:
       if (byte >= 32 && byte <= 126) { // printable ASCII
         if (line_pos < LINE_LEN - 1) {
-          kprintf("%c", byte);
+          console_print((const char*)&byte, 1);
           line_buffer[line_pos++] = byte;
-          cursor_col++;
         }
       } else if (byte == 8 || byte == 127) { // backspace
         if (line_pos > 0) {
           line_pos--;
           cursor_left();
-          kprintf(" ");
+          console_print(" ", 1);
+          cursor_left();
           //cursor_left();
         }
       } else if (byte == '\n' || byte == '\r') { // enter
@@ -109,14 +317,11 @@ void console_echo(uint8_t byte) {
           cursor_at(saved_row, saved_col);
         }
 
-        kprintf("\n");
-        cursor_row++;
-        cursor_col = 0;
+        console_newline("\r\n", 2);
         line_pos = 0;
       } else if (byte == 3) { // Ctrl-C
-        kprintf("^C\n");
-        cursor_row++;
-        cursor_col = 0;
+        console_print("^C", 2);
+        console_newline("\r\n", 2);
         line_pos = 0;
       } else if (byte == 27) {
         echo_state = ESCAPE;
@@ -149,4 +354,5 @@ void console_echo(uint8_t byte) {
       echo_state = NORMAL;
       break;
   }
+  prof_end(&echo_scope);
 }
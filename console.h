@@ -43,6 +43,15 @@
 #define BG_CYAN (CYAN+10)
 #define BG_WHITE (WHITE+10)
 
+/*
+ * The console keeps track of the terminal, where its cursor is and
+ * its colors, as long as nothing else is sent to UART0, see
+ * uart_tx_bytes(), so that the functions below send the shortest
+ * sequence to get there, or nothing when the terminal is already
+ * there. Once something else was sent, the next move is absolute,
+ * and the next color is set again.
+ */
+
 /*
  * Functions to move the cursor from its current position
  */
@@ -72,6 +81,28 @@ void cursor_show();
  */
 void console_color(uint8_t color);
 
+/*
+ * Function to set both the ink and background colors at once,
+ * in a single escape sequence, COLOR_RESET for the default ones.
+ */
+void console_colors(uint8_t ink, uint8_t bg);
+
+/*
+ * The shortest sequence that moves the cursor from a cell to another,
+ * of at most CONSOLE_MOTION_MAX bytes, not terminated, in s: nothing,
+ * a relative move, a carriage return and line feed, or an absolute
+ * move, the only one possible if from_col is negative, the position
+ * of the cursor being unknown. Returns the length of the sequence.
+ */
+#define CONSOLE_MOTION_MAX 16
+int console_motion(char* s, int from_row, int from_col, int row, int col);
+
+/*
+ * Tell the console that the terminal is back at its cursor, in the
+ * default colors, after something else was sent, see fb_flush().
+ */
+void console_resync(void);
+
 /*
  * Clears the terminal, like the bash command `clear`.
  * Positions the cursor at (0,0).
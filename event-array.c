@@ -0,0 +1,56 @@
+#include "event-queue.h"
+#include "main.h" // For NULL
+
+/*
+ * The original event queue: an unsorted array of the pending
+ * events, inserting is appending, but finding the next event
+ * scans the whole array. It is kept to compare the other
+ * backends against it.
+ */
+static struct event* slots[MAX_EVENTS];
+static int num_events = 0;
+
+void evq_init(void) {
+    num_events = 0;
+}
+
+void evq_insert(struct event* evt) {
+    if (num_events >= MAX_EVENTS)
+        return; // cannot happen, the pool has MAX_EVENTS events
+    evt->qidx = num_events;
+    slots[num_events++] = evt;
+}
+
+void evq_remove(struct event* evt) {
+    int i = evt->qidx;
+    slots[i] = slots[--num_events];
+    slots[i]->qidx = i;
+}
+
+struct event* evq_pop_expired(uint64_t now) {
+    int best = -1;
+    uint64_t min_eta = UINT64_MAX;
+
+    // Find the next event that is ready to run
+    for (int i = 0; i < num_events; i++) {
+        if (slots[i]->eta < min_eta) {
+            min_eta = slots[i]->eta;
+            best = i;
+        }
+    }
+    if (best == -1 || min_eta > now)
+        return NULL;
+
+    struct event* evt = slots[best];
+    slots[best] = slots[--num_events];
+    slots[best]->qidx = best;
+    return evt;
+}
+
+uint64_t evq_next_eta(void) {
+    uint64_t min_eta = UINT64_MAX;
+    for (int i = 0; i < num_events; i++)
+        if (slots[i]->eta < min_eta)
+            min_eta = slots[i]->eta;
+    return min_eta;
+}
@@ -0,0 +1,90 @@
+#include "event-queue.h"
+#include "main.h" // For NULL
+
+/*
+ * Pending events are kept in a binary min-heap ordered by eta,
+ * so the next event to run is always at heap[0]. Each event
+ * records its position in the heap in its qidx field.
+ */
+static struct event* heap[MAX_EVENTS];
+static int num_events = 0;
+
+static void heap_swap(int i, int j) {
+    struct event* tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    heap[i]->qidx = i;
+    heap[j]->qidx = j;
+}
+
+// move the event at index i up, until its parent is not later than it
+static void heap_up(int i) {
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (heap[parent]->eta <= heap[i]->eta)
+            break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+// move the event at index i down, until its children are not earlier than it
+static void heap_down(int i) {
+    for (;;) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int min = i;
+        if (left < num_events && heap[left]->eta < heap[min]->eta)
+            min = left;
+        if (right < num_events && heap[right]->eta < heap[min]->eta)
+            min = right;
+        if (min == i)
+            break;
+        heap_swap(i, min);
+        i = min;
+    }
+}
+
+void evq_init(void) {
+    num_events = 0;
+}
+
+void evq_insert(struct event* evt) {
+    if (num_events >= MAX_EVENTS)
+        return; // cannot happen, the pool has MAX_EVENTS events
+    evt->qidx = num_events;
+    heap[num_events++] = evt;
+    heap_up(evt->qidx);
+}
+
+void evq_remove(struct event* evt) {
+    int i = evt->qidx;
+    num_events--;
+    if (i == num_events)
+        return;
+    // the last event fills the hole, and may have to go either way
+    struct event* moved = heap[num_events];
+    heap[i] = moved;
+    moved->qidx = i;
+    heap_up(i);
+    heap_down(moved->qidx);
+}
+
+struct event* evq_pop_expired(uint64_t now) {
+    if (num_events == 0 || heap[0]->eta > now)
+        return NULL;
+    struct event* evt = heap[0];
+    num_events--;
+    if (num_events > 0) {
+        heap[0] = heap[num_events];
+        heap[0]->qidx = 0;
+        heap_down(0);
+    }
+    return evt;
+}
+
+uint64_t evq_next_eta(void) {
+    if (num_events == 0)
+        return UINT64_MAX;
+    return heap[0]->eta;
+}
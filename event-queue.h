@@ -0,0 +1,58 @@
+/*
+ * event-queue.h
+ *
+ * Internal interface between the scheduler (event.c) and the
+ * timer queue that keeps the pending events ordered by eta.
+ * Exactly one backend is linked in, chosen by the EVENT_QUEUE
+ * variable of the Makefile:
+ *   - heap:  binary min-heap, O(log n) insert and expiry (event-heap.c)
+ *   - wheel: hierarchical timing wheel, O(1) insert and amortized
+ *            O(1) expiry (event-wheel.c)
+ *   - array: the original unsorted array, scanned on every
+ *            expiry, kept as a reference point (event-array.c)
+ */
+
+#ifndef _EVENT_QUEUE_H_
+#define _EVENT_QUEUE_H_
+
+#include <stdint.h>
+#include "event.h"
+
+/*
+ * Maximum number of pending events, it sizes the event pool
+ * and the tables of the backends that need one.
+ */
+#ifndef MAX_EVENTS
+#define MAX_EVENTS 128
+#endif
+
+/*
+ * Reset the queue to empty.
+ */
+void evq_init(void);
+
+/*
+ * Insert an event, its eta must be set.
+ */
+void evq_insert(struct event* evt);
+
+/*
+ * Remove an event, it must be in the queue.
+ */
+void evq_remove(struct event* evt);
+
+/*
+ * Remove and return one event whose eta is not later than now,
+ * or NULL if there is none. The given time never goes backward
+ * from one call to the next.
+ */
+struct event* evq_pop_expired(uint64_t now);
+
+/*
+ * Returns a time at which evq_pop_expired() may return an event,
+ * that is, never later than the earliest eta in the queue.
+ * Returns UINT64_MAX if the queue is empty.
+ */
+uint64_t evq_next_eta(void);
+
+#endif /* _EVENT_QUEUE_H_ */
@@ -0,0 +1,208 @@
+#include "event-queue.h"
+#include "main.h" // For NULL
+
+/*
+ * Hierarchical timing wheel, in the spirit of Varghese & Lauck.
+ *
+ * There are WHEEL_LEVELS wheels of WHEEL_SLOTS slots each, a slot
+ * at level L covers 32^L ticks. An event is placed at the lowest
+ * level where its eta and the current wheel time only differ in
+ * the bits of that level, so inserting is O(1). When the wheel
+ * time reaches the start of an occupied slot at a level above 0,
+ * its events are cascaded down, and reaching an occupied slot at
+ * level 0 moves its events to the expired list. Events too far
+ * in the future for the top level wait in an overflow list that
+ * is cascaded each time the top level wraps around.
+ *
+ * Rather than stepping tick per tick, the wheel jumps straight
+ * to the next occupied slot, found with the per-level bitmaps
+ * of occupied slots, so idle time is free.
+ *
+ * Each slot is a doubly-linked list through the next/prev fields
+ * of the events, qidx is the list the event is on.
+ */
+#define WHEEL_BITS 5
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 5
+
+#define OVERFLOW_LIST (WHEEL_LEVELS * WHEEL_SLOTS)
+#define EXPIRED_LIST (OVERFLOW_LIST + 1)
+#define NLISTS (EXPIRED_LIST + 1)
+
+static struct event* lists[NLISTS];
+static struct event* expired_tail;
+static uint32_t occupied[WHEEL_LEVELS];
+static uint64_t wheel_time;
+static int num_waiting; // events in the slots or the overflow list
+
+static void list_push(int list, struct event* evt) {
+    evt->qidx = list;
+    evt->prev = NULL;
+    evt->next = lists[list];
+    if (lists[list] != NULL)
+        lists[list]->prev = evt;
+    lists[list] = evt;
+}
+
+static void expired_append(struct event* evt) {
+    evt->qidx = EXPIRED_LIST;
+    evt->next = NULL;
+    evt->prev = expired_tail;
+    if (expired_tail != NULL)
+        expired_tail->next = evt;
+    else
+        lists[EXPIRED_LIST] = evt;
+    expired_tail = evt;
+}
+
+// detach and return a whole list
+static struct event* list_take(int list) {
+    struct event* head = lists[list];
+    lists[list] = NULL;
+    return head;
+}
+
+static void wheel_place(struct event* evt) {
+    uint64_t diff = evt->eta ^ wheel_time;
+
+    if (evt->eta <= wheel_time) {
+        expired_append(evt);
+        return;
+    }
+    num_waiting++;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if ((diff >> (WHEEL_BITS * (level + 1))) == 0) {
+            int slot = (evt->eta >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            list_push(level * WHEEL_SLOTS + slot, evt);
+            occupied[level] |= 1u << slot;
+            return;
+        }
+    }
+    list_push(OVERFLOW_LIST, evt);
+}
+
+// re-place all the events of a detached list
+static void wheel_cascade(struct event* evt) {
+    while (evt != NULL) {
+        struct event* next = evt->next;
+        num_waiting--;
+        wheel_place(evt);
+        evt = next;
+    }
+}
+
+/*
+ * The next time, after the wheel time, at which something has to
+ * be done: the start of the earliest occupied slot, at any level,
+ * or the wrap-around of the top level if the overflow list is not
+ * empty. All the occupied slots of a level are ahead of the current
+ * slot of that level, so the earliest one is the lowest one.
+ */
+static uint64_t wheel_next(void) {
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if (occupied[level] == 0)
+            continue;
+        int shift = WHEEL_BITS * level;
+        uint64_t base = (wheel_time >> (shift + WHEEL_BITS)) << (shift + WHEEL_BITS);
+        uint64_t start = base + ((uint64_t) __builtin_ctz(occupied[level]) << shift);
+        if (start < next)
+            next = start;
+    }
+    if (lists[OVERFLOW_LIST] != NULL) {
+        int shift = WHEEL_BITS * WHEEL_LEVELS;
+        uint64_t wrap = ((wheel_time >> shift) + 1) << shift;
+        if (wrap < next)
+            next = wrap;
+    }
+    return next;
+}
+
+// advance the wheel time up to now, expiring the events on the way
+static void wheel_advance(uint64_t now) {
+    while (num_waiting > 0) {
+        uint64_t next = wheel_next();
+        if (next > now)
+            break;
+        wheel_time = next;
+
+        // cascade from the top, so that events go down level by level
+        int top = WHEEL_BITS * WHEEL_LEVELS;
+        if ((next & ((1ull << top) - 1)) == 0)
+            wheel_cascade(list_take(OVERFLOW_LIST));
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            int shift = WHEEL_BITS * level;
+            int slot = (next >> shift) & WHEEL_MASK;
+            if ((next & ((1ull << shift) - 1)) == 0 && (occupied[level] & (1u << slot))) {
+                occupied[level] &= ~(1u << slot);
+                wheel_cascade(list_take(level * WHEEL_SLOTS + slot));
+            }
+        }
+        int slot = next & WHEEL_MASK;
+        if (occupied[0] & (1u << slot)) {
+            occupied[0] &= ~(1u << slot);
+            struct event* evt = list_take(slot);
+            while (evt != NULL) {
+                struct event* next_evt = evt->next;
+                num_waiting--;
+                expired_append(evt);
+                evt = next_evt;
+            }
+        }
+    }
+    if (now > wheel_time)
+        wheel_time = now;
+}
+
+void evq_init(void) {
+    for (int i = 0; i < NLISTS; i++)
+        lists[i] = NULL;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+        occupied[level] = 0;
+    expired_tail = NULL;
+    wheel_time = 0;
+    num_waiting = 0;
+}
+
+void evq_insert(struct event* evt) {
+    wheel_place(evt);
+}
+
+void evq_remove(struct event* evt) {
+    int list = evt->qidx;
+    if (evt->prev != NULL)
+        evt->prev->next = evt->next;
+    else
+        lists[list] = evt->next;
+    if (evt->next != NULL)
+        evt->next->prev = evt->prev;
+    else if (list == EXPIRED_LIST)
+        expired_tail = evt->prev;
+    if (list == EXPIRED_LIST)
+        return;
+    num_waiting--;
+    if (list < OVERFLOW_LIST && lists[list] == NULL) {
+        int level = list / WHEEL_SLOTS;
+        occupied[level] &= ~(1u << (list & WHEEL_MASK));
+    }
+}
+
+struct event* evq_pop_expired(uint64_t now) {
+    wheel_advance(now);
+    struct event* evt = lists[EXPIRED_LIST];
+    if (evt == NULL)
+        return NULL;
+    lists[EXPIRED_LIST] = evt->next;
+    if (evt->next != NULL)
+        evt->next->prev = NULL;
+    else
+        expired_tail = NULL;
+    return evt;
+}
+
+uint64_t evq_next_eta(void) {
+    if (lists[EXPIRED_LIST] != NULL)
+        return wheel_time;
+    return wheel_next();
+}
@@ -1,73 +1,740 @@
 #include "event.h"
+#include "event-queue.h"
 #include "main.h" // For NULL
+#include "timer.h"
+#include "isr.h"
+#include "prof.h"
+#include "atomic.h"
+#include "pool.h"
 #include <stddef.h>
 
-#define MAX_EVENTS 32
+/*
+ * Tickless idle: when no event is ready, rather than spinning on
+ * the clock, arm the wake-up timer for the earliest eta and halt
+ * the processor until then, or until a device interrupt.
+ * Events due within EVENT_IDLE_MIN ticks are waited for by
+ * spinning, sleeping for less would cost more than it saves.
+ */
+#ifndef EVENT_TICKLESS
+#define EVENT_TICKLESS 1
+#endif
+#define EVENT_IDLE_MIN 10
 
-// not a sorted list yet, maybe change later?
-static struct event event_queue[MAX_EVENTS];
-static int num_events = 0;
-static uint64_t ticks = 0;
+/*
+ * The longest sleep, in ticks, even with no event pending: the clock
+ * must be read at least once per wrap-around of its 32-bit counter,
+ * see timer_now(), so the processor wakes up at half of it.
+ */
+#define EVENT_IDLE_MAX (1ull << 31)
+
+/*
+ * The events are allocated from a pool of blocks (see pool.h), so
+ * that posting never has to search for an empty slot. The pool
+ * starts with the EVENT_POOL_EVENTS events of event_storage[], in
+ * the .pool section, and may grow up to MAX_EVENTS events, the most
+ * the timer queues are sized for (see event-queue.h). The pending
+ * events are ordered by the timer queue, whichever backend was
+ * chosen at build time. event_table[] finds an event from the index
+ * in its handle.
+ */
+#ifndef EVENT_POOL_EVENTS
+#define EVENT_POOL_EVENTS MAX_EVENTS
+#endif
+
+#if EVENT_POOL_EVENTS > MAX_EVENTS
+#error "the static event pool is larger than MAX_EVENTS"
+#endif
+
+static struct event event_storage[EVENT_POOL_EVENTS] POOL_SECTION;
+static struct pool event_pool;
+static struct event* event_table[MAX_EVENTS];
+static uint32_t num_events;
+
+/*
+ * What happened to the posts that found the pool empty, failed ones
+ * are counted apart for interrupt handlers, they cannot evict nor
+ * coalesce and must not race with the loop on the counters.
+ */
+static uint32_t overflow_failed;
+static uint32_t overflow_lost;
+static uint32_t overflow_evicted;
+static uint32_t overflow_coalesced;
+
+/*
+ * Interrupt handlers post their events through the inbox, a stack
+ * pushed to with exclusive accesses (see atomic.h), and the loop
+ * moves them into the timer queue at each step, in the order they
+ * were posted. The pool is shared likewise. This way, only the
+ * loop ever touches the timer queue and the ready lists, and neither
+ * the loop nor the handlers need to mask interrupts to post.
+ */
+static struct event* volatile inbox;
+
+/*
+ * Where an event is, for event_cancel() and event_reschedule().
+ * An event in the inbox is still EVENT_FREE, handlers do not get
+ * handles. A one-shot event is freed as soon as it is dispatched,
+ * a periodic one is EVENT_RUNNING until its reaction returns, and
+ * then goes back to the timer queue, EVENT_MOVED if it was
+ * rescheduled in the meantime, its eta being already set.
+ * A running periodic event that was cancelled has a zero period.
+ */
+#define EVENT_FREE    0
+#define EVENT_QUEUED  1
+#define EVENT_READY   2
+#define EVENT_RUNNING 3
+#define EVENT_MOVED   4
+
+/*
+ * Handles are the generation of the event in the upper 16 bits,
+ * never 0, and its index in the pool in the lower 16 bits.
+ */
+#define HANDLE_INDEX_BITS 16
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+
+/*
+ * The events whose eta is past leave the timer queue for the ready
+ * list of their priority class, a FIFO, so that they keep the order
+ * of their etas. The next event to run is the head of the first
+ * non-empty ready list. The lists are doubly linked, so that a
+ * ready event can be cancelled.
+ */
+struct ready_list {
+    struct event* head;
+    struct event* tail;
+};
+
+static struct ready_list ready[EVENT_PRIOS];
+
+/*
+ * Per-reaction statistics, kept by event_loop() for each reaction
+ * function: the number of dispatches, how late they were (the time
+ * of the dispatch minus the eta) and how long they ran, both as
+ * log2-scaled histograms, bucket b counting values in [2^(b-1),2^b),
+ * bucket 0 counting zeros, and the last bucket everything above.
+ * Lateness is in ticks, run times are in cycles when profiling
+ * is compiled in (see prof.h), in ticks otherwise.
+ * The reactions are found in a small open-addressing hash table,
+ * those that do not fit are not accounted for.
+ */
+#ifndef EVENT_STATS
+#define EVENT_STATS 1
+#endif
+#define STATS_REACTIONS 16
+#define STATS_BUCKETS 16
+
+struct event_stats {
+    void (*react)(void*);
+    uint32_t count;
+    uint32_t max_late;
+    uint32_t max_run;
+    uint32_t late[STATS_BUCKETS];
+    uint32_t run[STATS_BUCKETS];
+};
+
+#if EVENT_STATS
+static struct event_stats stats[STATS_REACTIONS];
+#endif
 
 uint64_t time_now(void) {
-    // For now a mocking ticker of a logical clock ...
-    return ticks++;
+    return timer_now();
 }
 
-void event_init(void) {
-    for (int i = 0; i < MAX_EVENTS; i++) {
-        event_queue[i].react = NULL;
+/*
+ * The index of the events posted with event_post_coalesced(), hashed
+ * on their reaction and cookie, each bucket is a list chained through
+ * the hnext field. An event leaves the index when it is freed, that
+ * is as soon as it is dispatched, if not cancelled or evicted before.
+ */
+#define COALESCE_BITS 5
+#define COALESCE_BUCKETS (1 << COALESCE_BITS)
+
+static struct event* coalesce_index[COALESCE_BUCKETS];
+
+static struct event** coalesce_bucket(void (*react)(void*), void* cookie) {
+    uint32_t h = (uint32_t)(uintptr_t)react ^ ((uint32_t)(uintptr_t)cookie >> 2);
+    h *= 2654435761u; // Knuth's multiplicative hash
+    return &coalesce_index[h >> (32 - COALESCE_BITS)];
+}
+
+static struct event* coalesce_find(void (*react)(void*), void* cookie) {
+    struct event* evt = *coalesce_bucket(react, cookie);
+    while (evt != NULL && (evt->react != react || evt->cookie != cookie))
+        evt = evt->hnext;
+    return evt;
+}
+
+static void coalesce_remove(struct event* evt) {
+    struct event** link = coalesce_bucket(evt->react, evt->cookie);
+    while (*link != evt)
+        link = &(*link)->hnext;
+    *link = evt->hnext;
+    evt->indexed = 0;
+}
+
+uint32_t event_pool_grow(void* mem, uint32_t bytes) {
+    uint32_t size = event_pool.block_size;
+    uint32_t count = 0;
+    uint8_t* block = (uint8_t*)mem;
+    // number the events before the pool hands them out
+    while ((count + 1) * size <= bytes && num_events + count < MAX_EVENTS) {
+        struct event* evt = (struct event*)(block + count * size);
+        evt->react = NULL;
+        evt->state = EVENT_FREE;
+        evt->gen = 1;
+        evt->indexed = 0;
+        evt->index = num_events + count;
+        event_table[evt->index] = evt;
+        count++;
     }
+    num_events += count;
+    return pool_grow(&event_pool, mem, count * size);
+}
+
+void event_init(void) {
+    timer_init();
+    inbox = NULL;
     num_events = 0;
+    overflow_failed = overflow_lost = 0;
+    overflow_evicted = overflow_coalesced = 0;
+    pool_init(&event_pool, sizeof(struct event));
+    event_pool_grow(event_storage, sizeof(event_storage));
+    for (int p = 0; p < EVENT_PRIOS; p++)
+        ready[p].head = ready[p].tail = NULL;
+    for (int b = 0; b < COALESCE_BUCKETS; b++)
+        coalesce_index[b] = NULL;
+    evq_init();
+}
+
+static struct event* event_alloc(void) {
+    return (struct event*)pool_alloc(&event_pool);
+}
+
+// forget an event, to free it or reuse its block for another post
+static void event_retire(struct event* evt) {
+    if (evt->indexed)
+        coalesce_remove(evt);
+    evt->react = NULL;
+    // outstanding handles on the event become stale
+    if (++evt->gen == 0)
+        evt->gen = 1;
+}
+
+static void event_free(struct event* evt) {
+    event_retire(evt);
+    evt->state = EVENT_FREE;
+    pool_free(&event_pool, evt);
+}
+
+static event_handle_t event_handle(struct event* evt) {
+    return ((uint32_t)evt->gen << HANDLE_INDEX_BITS) | evt->index;
+}
+
+// the event of a handle, or NULL if it is stale
+static struct event* event_lookup(event_handle_t handle) {
+    uint32_t index = handle & HANDLE_INDEX_MASK;
+    if (index >= num_events)
+        return NULL;
+    struct event* evt = event_table[index];
+    if (evt->gen != (handle >> HANDLE_INDEX_BITS) || evt->state == EVENT_FREE)
+        return NULL;
+    return evt;
+}
+
+// the priority class of a post, out of range ones being clamped
+static int event_prio(int prio) {
+    if (prio < EVENT_PRIO_HIGH)
+        return EVENT_PRIO_HIGH;
+    if (prio >= EVENT_PRIOS)
+        return EVENT_PRIOS - 1;
+    return prio;
+}
+
+static int event_pending(struct event* evt) {
+    return evt->state == EVENT_QUEUED || evt->state == EVENT_READY;
+}
+
+static void ready_unlink(struct event* evt) {
+    struct ready_list* list = &ready[evt->prio];
+    if (evt->prev != NULL)
+        evt->prev->next = evt->next;
+    else
+        list->head = evt->next;
+    if (evt->next != NULL)
+        evt->next->prev = evt->prev;
+    else
+        list->tail = evt->prev;
+}
+
+static void ready_append(struct event* evt) {
+    struct ready_list* list = &ready[evt->prio];
+    evt->state = EVENT_READY;
+    evt->next = NULL;
+    evt->prev = list->tail;
+    if (list->tail == NULL)
+        list->head = evt;
+    else
+        list->tail->next = evt;
+    list->tail = evt;
+}
+
+// take a pending event out of the timer queue or its ready list
+static void event_unlink(struct event* evt) {
+    if (evt->state == EVENT_QUEUED)
+        evq_remove(evt);
+    else
+        ready_unlink(evt);
+}
+
+/*
+ * The pending one-shot event of the least urgent priority class, if
+ * it is less urgent than prio, the one due last among them, or NULL.
+ * Periodic events are never evicted, nothing would bring them back.
+ */
+static struct event* event_victim(int prio) {
+    struct event* victim = NULL;
+    for (uint32_t i = 0; i < num_events; i++) {
+        struct event* evt = event_table[i];
+        if (!event_pending(evt) || evt->period != 0 || evt->prio <= prio)
+            continue;
+        if (victim == NULL || evt->prio > victim->prio ||
+                (evt->prio == victim->prio && evt->eta > victim->eta))
+            victim = evt;
+    }
+    return victim;
+}
+
+// a pending one-shot event with the same reaction and cookie, or NULL
+static struct event* event_duplicate(void (*react)(void*), void* cookie) {
+    struct event* evt = coalesce_find(react, cookie);
+    if (evt != NULL)
+        return evt;
+    // the events posted otherwise are not indexed
+    for (uint32_t i = 0; i < num_events; i++) {
+        struct event* evt = event_table[i];
+        if (event_pending(evt) && evt->period == 0 &&
+                evt->react == react && evt->cookie == cookie)
+            return evt;
+    }
+    return NULL;
+}
+
+/*
+ * Merge a post into a pending event, keeping the earlier eta and the
+ * more urgent priority of the two. A ready event is already due.
+ */
+static void event_merge(struct event* evt, uint64_t eta, int prio) {
+    if (evt->state == EVENT_QUEUED) {
+        if (eta < evt->eta || prio < evt->prio) {
+            evq_remove(evt);
+            if (eta < evt->eta)
+                evt->eta = eta;
+            if (prio < evt->prio)
+                evt->prio = prio;
+            evq_insert(evt);
+        }
+    } else if (prio < evt->prio) {
+        ready_unlink(evt);
+        evt->prio = prio;
+        ready_append(evt);
+    }
+}
+
+/*
+ * The pool is empty, apply the overflow policy of the post: either
+ * take the event of a less urgent one, reusing its block as is, so
+ * that an interrupt handler cannot take it in between, or merge the
+ * post into a pending duplicate, the earlier eta of the two being
+ * kept. Returns the event to use, or NULL if the post fails.
+ * The searches are linear, but only run when the pool is exhausted.
+ */
+static struct event* event_overflow(void (*react)(void*), void* cookie, uint64_t eta,
+        int prio, int policy, int* merged) {
+    struct event* evt;
+    switch (policy) {
+    case EVENT_OVERFLOW_EVICT:
+        evt = event_victim(prio);
+        if (evt == NULL)
+            break;
+        event_unlink(evt);
+        event_retire(evt);
+        overflow_evicted++;
+        return evt;
+    case EVENT_OVERFLOW_COALESCE:
+        evt = event_duplicate(react, cookie);
+        if (evt == NULL)
+            break;
+        overflow_coalesced++;
+        *merged = 1;
+        event_merge(evt, eta, prio);
+        return evt;
+    }
+    overflow_failed++;
+    return NULL;
+}
+
+/*
+ * Only the loop, that is reactions, may post this way,
+ * the timer queue is not protected against interrupt handlers.
+ * If merged is not NULL, it tells whether the post was merged into
+ * a pending duplicate rather than queued as an event of its own.
+ */
+static event_handle_t event_queue(void (*react)(void*), void* cookie, uint32_t delay,
+        uint32_t period, int prio, int policy, int* merged) {
+    uint64_t eta = time_now() + delay;
+    int dup = 0;
+    prio = event_prio(prio);
+    struct event* evt = event_alloc();
+    if (evt == NULL)
+        evt = event_overflow(react, cookie, eta, prio, policy, &dup);
+    if (merged != NULL)
+        *merged = dup;
+    if (evt == NULL)
+        return EVENT_NONE;
+    if (dup)
+        return event_handle(evt);
+
+    evt->eta = eta;
+    evt->cookie = cookie;
+    evt->react = react;
+    evt->period = period;
+    evt->prio = prio;
+    evt->state = EVENT_QUEUED;
+    evq_insert(evt);
+    return event_handle(evt);
+}
+
+event_handle_t event_post_policy(void (*react)(void*), void* cookie, uint32_t delay,
+        int prio, int policy) {
+    return event_queue(react, cookie, delay, 0, prio, policy, NULL);
+}
+
+event_handle_t event_post_coalesced(void (*react)(void*), void* cookie, uint32_t delay, int prio) {
+    struct event* evt = coalesce_find(react, cookie);
+    if (evt != NULL) {
+        event_merge(evt, time_now() + delay, event_prio(prio));
+        return event_handle(evt);
+    }
+    // a duplicate merged into on overflow was posted otherwise, it
+    // is left out of the index, as event_post_coalesced() found none
+    int merged;
+    event_handle_t handle = event_queue(react, cookie, delay, 0, prio,
+            EVENT_OVERFLOW_COALESCE, &merged);
+    evt = event_lookup(handle);
+    if (evt != NULL && !merged) {
+        struct event** bucket = coalesce_bucket(react, cookie);
+        evt->hnext = *bucket;
+        *bucket = evt;
+        evt->indexed = 1;
+    }
+    return handle;
+}
+
+event_handle_t event_post_prio(void (*react)(void*), void* cookie, uint32_t delay, int prio) {
+    return event_queue(react, cookie, delay, 0, prio, EVENT_OVERFLOW_FAIL, NULL);
+}
+
+int event_post_from_isr(void (*react)(void*), void* cookie, uint32_t delay, int prio) {
+    struct event* evt = event_alloc();
+    if (evt == NULL) {
+        overflow_lost++;
+        return 0;
+    }
+
+    evt->eta = time_now() + delay;
+    evt->cookie = cookie;
+    evt->react = react;
+    evt->period = 0;
+    evt->prio = event_prio(prio);
+    do {
+        evt->next = ldrex_ptr((void* volatile*)&inbox);
+    } while (strex_ptr((void* volatile*)&inbox, evt));
+    return 1;
 }
 
-void event_post(void (*react)(void*), void* cookie, uint32_t delay) {
-    if (num_events >= MAX_EVENTS) {
-        // what do I do here?
+/*
+ * Take the whole inbox at once, and insert its events in the timer
+ * queue, oldest first since the inbox is a stack.
+ */
+static void event_splice(void) {
+    struct event* evt;
+    if (inbox == NULL)
         return;
+    do {
+        evt = ldrex_ptr((void* volatile*)&inbox);
+    } while (strex_ptr((void* volatile*)&inbox, NULL));
+
+    struct event* fifo = NULL;
+    while (evt != NULL) {
+        struct event* next = evt->next;
+        evt->next = fifo;
+        fifo = evt;
+        evt = next;
     }
+    while (fifo != NULL) {
+        evt = fifo;
+        fifo = fifo->next;
+        evt->state = EVENT_QUEUED;
+        evq_insert(evt);
+    }
+}
+
+event_handle_t event_post(void (*react)(void*), void* cookie, uint32_t delay) {
+    return event_post_prio(react, cookie, delay, EVENT_PRIO_NORMAL);
+}
 
-    // Find an empty slot
-    int i = 0;
-    while(i < MAX_EVENTS && event_queue[i].react != NULL) {
-        i++;
+event_handle_t event_post_periodic_prio(void (*react)(void*), void* cookie, uint32_t period, int prio) {
+    return event_queue(react, cookie, period, period, prio, EVENT_OVERFLOW_FAIL, NULL);
+}
+
+event_handle_t event_post_periodic(void (*react)(void*), void* cookie, uint32_t period) {
+    return event_post_periodic_prio(react, cookie, period, EVENT_PRIO_NORMAL);
+}
+
+int event_cancel(event_handle_t handle) {
+    struct event* evt = event_lookup(handle);
+    if (evt == NULL)
+        return 0;
+    if (!event_pending(evt)) {
+        // cancelled from its own reaction, freed once it returns
+        if (evt->period == 0)
+            return 0;
+        evt->period = 0;
+        return 1;
     }
+    event_unlink(evt);
+    event_free(evt);
+    return 1;
+}
 
-    if (i < MAX_EVENTS) {
-        event_queue[i].eta = time_now() + delay;
-        event_queue[i].cookie = cookie;
-        event_queue[i].react = react;
-        num_events++;
+int event_reschedule(event_handle_t handle, uint32_t delay) {
+    struct event* evt = event_lookup(handle);
+    if (evt == NULL)
+        return 0;
+    if (!event_pending(evt)) {
+        // rescheduled from its own reaction, queued once it returns
+        if (evt->period == 0)
+            return 0;
+        evt->eta = time_now() + delay;
+        evt->state = EVENT_MOVED;
+        return 1;
     }
+    event_unlink(evt);
+    evt->eta = time_now() + delay;
+    evt->state = EVENT_QUEUED;
+    evq_insert(evt);
+    return 1;
 }
 
-void event_loop(void) {
-    for (;;) {
-        uint64_t now = time_now();
-        int best_event_idx = -1;
-        uint64_t min_eta = UINT64_MAX;
-
-        // Find the next event that is ready to run
-        for (int i = 0; i < MAX_EVENTS; i++) {
-            if (event_queue[i].react != NULL && event_queue[i].eta < min_eta) {
-                min_eta = event_queue[i].eta;
-                best_event_idx = i;
-            }
+#if EVENT_STATS
+static int stats_bucket(uint32_t value) {
+    if (value == 0)
+        return 0;
+    int bucket = 32 - __builtin_clz(value);
+    return (bucket < STATS_BUCKETS) ? bucket : STATS_BUCKETS - 1;
+}
+
+static struct event_stats* stats_lookup(void (*react)(void*)) {
+    uint32_t h = ((uintptr_t)react >> 2) & (STATS_REACTIONS - 1);
+    for (int i = 0; i < STATS_REACTIONS; i++) {
+        struct event_stats* st = &stats[(h + i) & (STATS_REACTIONS - 1)];
+        if (st->react == react)
+            return st;
+        if (st->react == NULL) {
+            st->react = react;
+            return st;
         }
+    }
+    return NULL;
+}
 
-        if (best_event_idx != -1 && event_queue[best_event_idx].eta <= now) {
-            // Found an event to run!
-            struct event evt = event_queue[best_event_idx];
-            
-            // mark as empty before running
-            event_queue[best_event_idx].react = NULL;
-            num_events--;
+static uint32_t stats_clamp(uint64_t value) {
+    return (value > UINT32_MAX) ? UINT32_MAX : (uint32_t)value;
+}
 
-            evt.react(evt.cookie);
+static void stats_record(void (*react)(void*), uint64_t late, uint32_t run) {
+    struct event_stats* st = stats_lookup(react);
+    if (st == NULL)
+        return;
+    uint32_t late32 = stats_clamp(late);
+    st->count++;
+    st->late[stats_bucket(late32)]++;
+    st->run[stats_bucket(run)]++;
+    if (late32 > st->max_late)
+        st->max_late = late32;
+    if (run > st->max_run)
+        st->max_run = run;
+}
 
+static void stats_histogram(const char* name, uint32_t* buckets) {
+    kprintf("  %-5s", name);
+    for (int b = 0; b < STATS_BUCKETS; b++)
+        kprintf(" %5u", buckets[b]);
+    kprintf("\n");
+}
+#endif
+
+void event_pool_info(struct event_pool_info* info) {
+    info->size = event_pool.blocks;
+    info->used = event_pool.used;
+    info->high_water = event_pool.high_water;
+    info->failed = overflow_failed;
+    info->lost = overflow_lost;
+    info->evicted = overflow_evicted;
+    info->coalesced = overflow_coalesced;
+}
+
+void event_stats_dump(void) {
+    struct event_pool_info info;
+    event_pool_info(&info);
+    kprintf("pool: %u events, %u used, high water %u, overflows: %u failed, %u lost, %u evicted, %u coalesced\n",
+        info.size, info.used, info.high_water, info.failed, info.lost, info.evicted, info.coalesced);
+#if EVENT_STATS
+#ifdef PROF
+    const char* run_unit = "cycles";
+#else
+    const char* run_unit = "ticks";
+#endif
+    kprintf("lateness in ticks, run time in %s, bucket b is [2^(b-1),2^b)\n", run_unit);
+    kprintf("  %-5s", "b");
+    for (int b = 0; b < STATS_BUCKETS; b++)
+        kprintf(" %5d", b);
+    kprintf("\n");
+    for (int i = 0; i < STATS_REACTIONS; i++) {
+        struct event_stats* st = &stats[i];
+        if (st->react == NULL)
+            continue;
+        kprintf("reaction %p: %u dispatches, max late %u, max run %u\n",
+            st->react, st->count, st->max_late, st->max_run);
+        stats_histogram("late", st->late);
+        stats_histogram("run", st->run);
+    }
+#endif
+}
+
+void event_stats_reset(void) {
+#if EVENT_STATS
+    // only the loop records the statistics, interrupts may go on
+    for (int i = 0; i < STATS_REACTIONS; i++)
+        stats[i] = (struct event_stats){ 0 };
+#endif
+}
+
+/*
+ * Interrupts are disabled while deciding to halt, or an interrupt
+ * handler posting an event to the inbox right before the wfi would
+ * not be noticed before the next wake-up. The wfi still wakes up on
+ * a pending interrupt, which is handled once they are enabled.
+ */
+static void event_idle(void) {
+    irqs_disable();
+    if (inbox != NULL) {
+        irqs_enable();
+        return;
+    }
+    uint64_t now = time_now();
+#if EVENT_TICKLESS
+    uint64_t eta = evq_next_eta();
+    if (eta != UINT64_MAX && eta <= now + EVENT_IDLE_MIN) {
+        irqs_enable();
+        return;
+    }
+#else
+    uint64_t eta = UINT64_MAX;
+#endif
+    if (eta > now + EVENT_IDLE_MAX)
+        eta = now + EVENT_IDLE_MAX;
+    timer_wakeup_at(eta);
+    wfi();
+    irqs_enable();
+    timer_wakeup_cancel();
+}
+
+/*
+ * Move the expired events from the timer queue to the ready lists,
+ * and take the most urgent ready one, if any.
+ */
+static struct event* event_ready(uint64_t now) {
+    struct event* evt;
+    while ((evt = evq_pop_expired(now)) != NULL)
+        ready_append(evt);
+    for (int p = 0; p < EVENT_PRIOS; p++) {
+        evt = ready[p].head;
+        if (evt != NULL) {
+            ready_unlink(evt);
+            return evt;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Reschedule a periodic event from its previous eta, skipping
+ * the periods that went by while it was late, if any.
+ */
+static void event_repeat(struct event* evt) {
+    uint64_t now = time_now();
+    evt->eta += evt->period;
+    while (evt->eta < now)
+        evt->eta += evt->period;
+    evt->state = EVENT_QUEUED;
+    evq_insert(evt);
+}
+
+int event_step(void) {
+    event_splice();
+    uint64_t now = time_now();
+    struct event* evt = event_ready(now);
+
+    if (evt == NULL)
+        return 0;
+
+    // Found an event to run!
+    void (*react)(void*) = evt->react;
+    void* cookie = evt->cookie;
+    uint64_t late = now - evt->eta;
+
+    // release a one-shot event before running, so that the reaction
+    // may post again, a periodic one is rescheduled afterwards.
+    int periodic = (evt->period != 0);
+    if (periodic)
+        evt->state = EVENT_RUNNING;
+    else
+        event_free(evt);
+
+    PROF_SCOPE(dispatch_scope, "dispatch");
+    prof_begin(&dispatch_scope);
+#if EVENT_STATS
+#ifdef PROF
+    uint32_t start = prof_cycles();
+    react(cookie);
+    stats_record(react, late, prof_cycles() - start);
+#else
+    uint64_t start = time_now();
+    react(cookie);
+    stats_record(react, late, stats_clamp(time_now() - start));
+#endif
+#else
+    react(cookie);
+#endif
+    prof_end(&dispatch_scope);
+
+    if (periodic) {
+        if (evt->period == 0) {
+            event_free(evt);
+        } else if (evt->state == EVENT_MOVED) {
+            evt->state = EVENT_QUEUED;
+            evq_insert(evt);
         } else {
-            // No events ready, wait for interrupt? what else can I do here?
-            asm volatile("wfi");
+            event_repeat(evt);
         }
     }
+    return 1;
+}
+
+void event_loop(void) {
+    for (;;) {
+        if (!event_step())
+            event_idle();
+    }
 }
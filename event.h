@@ -8,36 +8,221 @@
  * 
  * cookie is a pointer to context data for the reaction function.
  * react is a function pointer to the event handler (the "reaction").
- * eta is the Estimated Time of Arrival for the event, in system ticks.
+ * eta is the Estimated Time of Arrival for the event, in system ticks,
+ * see time_now().
+ * prio is its priority class, see event_post_prio().
+ * period is the period of a periodic event, 0 for a one-shot event.
+ * gen, index, indexed, state, qidx, next, prev and hnext are private
+ * to the scheduler and its timer queue (see event-queue.h), like the
+ * position of a pending event in the timer heap, or the links of the
+ * list it is on.
  */
 struct event {
     void* cookie;
     void (*react)(void* cookie);
     uint64_t eta;
+    uint32_t period;
+    uint16_t gen;
+    uint16_t index;
+    uint8_t indexed;
+    int prio;
+    int state;
+    int qidx;
+    struct event* next;
+    struct event* prev;
+    struct event* hnext;
 };
 
 /**
- * Initialize the event scheduler.
+ * A handle on a posted event, to cancel or reschedule it. It holds
+ * the index of the event in the pool and a generation number, that
+ * changes each time the event is freed, so that a handle on an event
+ * that already ran, or was cancelled, is recognized as stale rather
+ * than designating whatever event reuses the slot. Generations wrap
+ * around after 65535 reuses of the same slot.
+ * EVENT_NONE is never a valid handle.
+ */
+typedef uint32_t event_handle_t;
+#define EVENT_NONE 0
+
+/**
+ * Initialize the event scheduler, and its time base.
  */
 void event_init(void);
 
+/**
+ * Priority classes of the events, from the most to the least urgent.
+ * Among the events that are ready, those of a higher priority always
+ * run first, in the order of their eta within a class. Reactions are
+ * not preempted, so an interactive event waits at most for the
+ * reaction that is running when it gets ready, whatever the number
+ * of less urgent events that are ready too. A priority out of this
+ * range is taken as the nearest class.
+ */
+#define EVENT_PRIO_HIGH   0 // interactive work, like user input
+#define EVENT_PRIO_NORMAL 1
+#define EVENT_PRIO_LOW    2 // cosmetic work, like animations
+#define EVENT_PRIOS       3
+
 /**
  * Post a new event to the event queue.
  * 
  * react is the reaction function to call when the event fires.
  * cookie is a context pointer to pass to the reaction.
- * delay is the delay from now (in ticks?) when the event should fire.
+ * delay is the delay from now, in ticks, when the event should fire.
+ * prio is its priority class, one of EVENT_PRIO_*.
+ * Returns a handle on the event, valid until it is dispatched,
+ * or EVENT_NONE if there is no free event.
+ * Only from the event loop, that is from reactions or before
+ * event_loop() is called, see event_post_from_isr() otherwise.
+ */
+event_handle_t event_post_prio(void (*react)(void*), void* cookie, uint32_t delay, int prio);
+
+/**
+ * Post a new event from an interrupt handler, like event_post_prio().
+ * The event goes through a lock-free inbox that the loop empties into
+ * its queue at each step, so neither side masks interrupts.
+ * Returns 1 if the event was posted, 0 if there was no free event,
+ * the post being lost, and counted as such, see event_pool_info().
+ */
+int event_post_from_isr(void (*react)(void*), void* cookie, uint32_t delay, int prio);
+
+/**
+ * What to do when posting finds no free event, see event_post_policy():
+ *   - FAIL:     the post fails, EVENT_NONE is returned;
+ *   - EVICT:    the pending one-shot event of the least urgent class,
+ *               if less urgent than the new one, is dropped to make
+ *               room, the one due last among them, otherwise it fails;
+ *   - COALESCE: if a one-shot event with the same reaction and cookie
+ *               is pending, the post is merged into it, keeping the
+ *               earlier of both etas, and its handle is returned,
+ *               otherwise it fails.
+ * Every overflow is counted, see event_pool_info().
+ */
+#define EVENT_OVERFLOW_FAIL     0
+#define EVENT_OVERFLOW_EVICT    1
+#define EVENT_OVERFLOW_COALESCE 2
+
+/**
+ * Post a new event like event_post_prio(), with the given overflow
+ * policy, one of EVENT_OVERFLOW_*. event_post_prio() and the other
+ * posting functions use EVENT_OVERFLOW_FAIL.
+ */
+event_handle_t event_post_policy(void (*react)(void*), void* cookie, uint32_t delay,
+        int prio, int policy);
+
+/**
+ * Post a new event like event_post_prio(), unless an event posted
+ * this way with the same reaction and cookie is still pending: the
+ * post is then merged into it, keeping the earlier eta and the more
+ * urgent priority, and its handle is returned. Repeated requests for
+ * the same work, like redraws, thus run once. Once its reaction is
+ * dispatched, the next post starts a new event.
+ * The pending event is found in O(1) through a hash index.
+ */
+event_handle_t event_post_coalesced(void (*react)(void*), void* cookie, uint32_t delay, int prio);
+
+/**
+ * Post a new event of EVENT_PRIO_NORMAL priority, see event_post_prio().
+ */
+event_handle_t event_post(void (*react)(void*), void* cookie, uint32_t delay);
+
+/**
+ * Post a periodic event, whose reaction runs every period ticks,
+ * the first time one period from now, until it is cancelled.
+ * The event is rescheduled from its previous eta, not from the
+ * time it actually ran, so that lateness does not accumulate into
+ * drift. When the loop was held up for more than a period, the
+ * periods that went by are skipped rather than run in a burst.
+ * Returns a handle on the event, valid until it is cancelled, or
+ * EVENT_NONE if there is no free event.
+ * Only from the event loop, like event_post_prio().
+ */
+event_handle_t event_post_periodic_prio(void (*react)(void*), void* cookie, uint32_t period, int prio);
+
+/**
+ * Post a periodic event of EVENT_PRIO_NORMAL priority,
+ * see event_post_periodic_prio().
  */
-void event_post(void (*react)(void*), void* cookie, uint32_t delay);
+event_handle_t event_post_periodic(void (*react)(void*), void* cookie, uint32_t period);
+
+/**
+ * Cancel a posted event, it will not run, even if it was ready to.
+ * A periodic event may also cancel itself from its reaction.
+ * Returns 1 if the event was cancelled, 0 if the handle is stale,
+ * the event having run or been cancelled already.
+ * In O(log n) at worst, depending on the timer queue.
+ * Only from the event loop.
+ */
+int event_cancel(event_handle_t handle);
+
+/**
+ * Move a posted event to delay ticks from now, like a timeout
+ * being restarted. A periodic event keeps its period from there.
+ * Returns 1 if the event was rescheduled, 0 if the handle is stale.
+ * In O(log n) at worst, depending on the timer queue.
+ * Only from the event loop.
+ */
+int event_reschedule(event_handle_t handle, uint32_t delay);
 
 /**
  * Start the main event loop. function never returns.
+ * It runs the events as they become ready, see event_step,
+ * and idles the processor in between.
  */
 void event_loop(void);
 
 /**
- * Gets the current system time in ticks.
- * return the current time (mocked?).
+ * Run the next event, if one is ready.
+ * Returns 1 if an event was run, 0 otherwise.
+ */
+int event_step(void);
+
+/**
+ * Print, on UART0, the occupation of the event pool, then the
+ * statistics of each reaction dispatched so far: the number of
+ * dispatches, and the histograms of how late they were dispatched and
+ * how long they ran. Reactions are identified by the address of their
+ * function, look it up with addr2line or nm.
+ */
+void event_stats_dump(void);
+
+/**
+ * Reset the statistics of the reactions.
+ */
+void event_stats_reset(void);
+
+/**
+ * The occupation of the event pool, to size it from real data:
+ * its size and number of events in use, in events, the most events
+ * ever in use at once, and the number of posts that overflowed,
+ * by outcome, failed posts from interrupt handlers being lost.
+ */
+struct event_pool_info {
+    uint32_t size;
+    uint32_t used;
+    uint32_t high_water;
+    uint32_t failed;
+    uint32_t lost;
+    uint32_t evicted;
+    uint32_t coalesced;
+};
+
+void event_pool_info(struct event_pool_info* info);
+
+/**
+ * Give more memory to the event pool, which starts with a static
+ * array of EVENT_POOL_EVENTS events, see the Makefile. The memory
+ * must be 8-byte aligned and stay allocated, it is cut in as many
+ * events as fit, up to MAX_EVENTS in all. Returns the number of
+ * events added. Only from the event loop.
+ */
+uint32_t event_pool_grow(void* mem, uint32_t bytes);
+
+/**
+ * Gets the current system time in ticks, since event_init().
+ * The time base is the SP804 timer 0, see timer.h, so a tick
+ * is a microsecond (TIMER_HZ).
  */
 uint64_t time_now(void);
 
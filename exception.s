@@ -39,8 +39,23 @@ unused_handler_addr: .word _unused_handler
 irq_handler_addr: .word _isr_handler
 fiq_handler_addr: .word _fiq_handler
 
+/*
+ * The IRQ handler, the processor is in IRQ mode, on the IRQ stack
+ * (see _irqs_setup in irq.S), with IRQs disabled. LR_irq is the
+ * address of the interrupted instruction plus 4.
+ * Save the registers that C code may clobber, upcall isr() in isr.c
+ * and return to the interrupted instruction, the ^ restoring the
+ * CPSR from SPSR_irq. Fourteen registers keep the stack 8-byte
+ * aligned, as required to call C code.
+ * The clrex makes an interrupted ldrex/strex sequence fail and
+ * retry, the handler may have changed the location (see atomic.h).
+ */
 _isr_handler:
-    b _isr_handler
+    sub lr, lr, #4
+    stmfd sp!, {r0-r12, lr}
+    bl isr
+    clrex
+    ldmfd sp!, {r0-r12, pc}^
 
 _unused_handler:
     b _unused_handler // unused interrupt occurred
@@ -113,6 +128,7 @@ _data_abort_handler:
  1: b 1b // loop for debug
 
 .global _panic
+   .type _panic, %function
    .func _panic
 _panic:
 	b _panic
@@ -0,0 +1,218 @@
+#include "fb.h"
+#include "main.h"
+#include "uart.h"
+
+#if NROWS > 32
+#error "the dirty rows of the framebuffer are the bits of a uint32_t"
+#endif
+
+/*
+ * A cell, its character being FB_NONE if the framebuffer does not
+ * draw it, or FB_STALE, in the front buffer only, if the terminal
+ * may not show what was drawn there, see fb_invalidate().
+ */
+struct fb_cell {
+  uint8_t ch;
+  uint8_t attr;
+};
+
+#define FB_NONE  0
+#define FB_STALE 0xff
+
+// the cells as drawn, and as the terminal shows them
+static struct fb_cell back[NROWS][NCOLS];
+static struct fb_cell front[NROWS][NCOLS];
+
+// a bit per row with cells drawn since the last flush
+static uint32_t dirty;
+
+/*
+ * The state of the terminal during a flush, its cursor, the column
+ * being -1 after the last one was written, the terminal waiting
+ * there to wrap, and the current attribute.
+ */
+static int term_row;
+static int term_col;
+static uint8_t term_attr;
+
+/*
+ * The output of a flush, sent by chunks.
+ */
+#define FB_OUT_SIZE 128
+
+static uint8_t out[FB_OUT_SIZE];
+static uint32_t out_len;
+
+static void fb_send(void) {
+  if (out_len > 0)
+    uart_send_buffer(UART0, out, out_len);
+  out_len = 0;
+}
+
+static void fb_emit(const char* s, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    if (out_len == FB_OUT_SIZE)
+      fb_send();
+    out[out_len++] = s[i];
+  }
+}
+
+void fb_init(void) {
+  for (int row = 0; row < NROWS; row++)
+    for (int col = 0; col < NCOLS; col++) {
+      back[row][col].ch = FB_NONE;
+      back[row][col].attr = FB_DEFAULT;
+      front[row][col] = back[row][col];
+    }
+  dirty = 0;
+}
+
+void fb_put(int row, int col, char c, uint8_t attr) {
+  if (row < 0 || row >= NROWS || col < 0 || col >= NCOLS)
+    return;
+  if (c < 32 || c > 126)
+    c = ' ';
+  struct fb_cell* cell = &back[row][col];
+  if (cell->ch == (uint8_t)c && cell->attr == attr)
+    return;
+  cell->ch = c;
+  cell->attr = attr;
+  dirty |= 1u << row;
+}
+
+void fb_puts(int row, int col, const char* s, uint8_t attr) {
+  for (; *s != '\0' && col < NCOLS; s++, col++)
+    fb_put(row, col, *s, attr);
+}
+
+void fb_fill(int row, int col, int rows, int cols, char c, uint8_t attr) {
+  for (int r = row; r < row + rows; r++)
+    for (int k = col; k < col + cols; k++)
+      fb_put(r, k, c, attr);
+}
+
+void fb_release(int row, int col) {
+  if (row < 0 || row >= NROWS || col < 0 || col >= NCOLS)
+    return;
+  back[row][col].ch = FB_NONE;
+  back[row][col].attr = FB_DEFAULT;
+  front[row][col] = back[row][col];
+}
+
+void fb_invalidate(void) {
+  for (int row = 0; row < NROWS; row++)
+    for (int col = 0; col < NCOLS; col++)
+      if (back[row][col].ch != FB_NONE) {
+        front[row][col].ch = FB_STALE;
+        dirty |= 1u << row;
+      }
+}
+
+/*
+ * Set the attribute of what is sent next, the changed colors only,
+ * or both after a reset when a color goes back to the default.
+ */
+static void fb_attr(uint8_t attr) {
+  char s[12];
+  int len = 0;
+  uint8_t ink = attr & 0xf, bg = attr >> 4;
+  uint8_t term_ink = term_attr & 0xf, term_bg = term_attr >> 4;
+
+  if (attr == term_attr)
+    return;
+  s[len++] = 27;
+  s[len++] = '[';
+  if ((term_ink && !ink) || (term_bg && !bg)) {
+    s[len++] = '0';
+    term_ink = term_bg = 0;
+  }
+  if (ink != term_ink) {
+    if (len > 2)
+      s[len++] = ';';
+    s[len++] = '3';
+    s[len++] = '0' + ink - 1;
+  }
+  if (bg != term_bg) {
+    if (len > 2)
+      s[len++] = ';';
+    s[len++] = '4';
+    s[len++] = '0' + bg - 1;
+  }
+  s[len++] = 'm';
+  fb_emit(s, len);
+  term_attr = attr;
+}
+
+/*
+ * Move the cursor to the given cell. Forward on the same row, the
+ * cells in between are sent again rather than skipped when that is
+ * shorter, if they are drawn, unchanged, in the current attribute.
+ */
+static void fb_goto(int row, int col) {
+  char s[CONSOLE_MOTION_MAX];
+
+  if (row == term_row && col == term_col)
+    return;
+  int len = console_motion(s, term_row, term_col, row, col);
+  if (row == term_row && term_col >= 0 && col > term_col && col - term_col <= len) {
+    int k;
+    for (k = term_col; k < col; k++) {
+      struct fb_cell* cell = &front[row][k];
+      if (cell->ch == FB_NONE || cell->ch == FB_STALE || cell->attr != term_attr)
+        break;
+    }
+    if (k == col) {
+      for (k = term_col; k < col; k++)
+        fb_emit((const char*)&front[row][k].ch, 1);
+      term_col = col;
+      return;
+    }
+  }
+  fb_emit(s, len);
+  term_row = row;
+  term_col = col;
+}
+
+uint32_t fb_flush(void) {
+  int row, col;
+
+  if (dirty == 0)
+    return 0;
+  // what the console sends first is part of the flush
+  uint32_t sent = uart_tx_bytes(UART0);
+  // start from the console's cursor, in the default colors, the
+  // console sending nothing if the terminal is already so
+  cursor_position(&term_row, &term_col);
+  cursor_at(term_row, term_col);
+  console_colors(COLOR_RESET, COLOR_RESET);
+  // the terminal keeps its cursor on the screen, the console does not
+  if (term_row >= NROWS)
+    term_row = NROWS - 1;
+  if (term_col >= NCOLS)
+    term_col = NCOLS - 1;
+  int home_row = term_row, home_col = term_col;
+  term_attr = FB_DEFAULT;
+
+  for (row = 0; row < NROWS; row++) {
+    if ((dirty & (1u << row)) == 0)
+      continue;
+    for (col = 0; col < NCOLS; col++) {
+      struct fb_cell* cell = &back[row][col];
+      if (cell->ch == front[row][col].ch && cell->attr == front[row][col].attr)
+        continue;
+      fb_goto(row, col);
+      fb_attr(cell->attr);
+      fb_emit((const char*)&cell->ch, 1);
+      front[row][col] = *cell;
+      term_col = (col < NCOLS - 1) ? col + 1 : -1;
+    }
+  }
+  dirty = 0;
+
+  // back to the console
+  fb_attr(FB_DEFAULT);
+  fb_goto(home_row, home_col);
+  fb_send();
+  console_resync();
+  return uart_tx_bytes(UART0) - sent;
+}
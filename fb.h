@@ -0,0 +1,65 @@
+#ifndef _FB_H_
+#define _FB_H_
+
+#include <stdint.h>
+#include "console.h"
+
+/*
+ * A shadow framebuffer of the terminal, NROWS x NCOLS cells, each
+ * one a character and an attribute, its colors. Drawing only writes
+ * into the framebuffer, fb_flush() then sends the cells that changed
+ * since the last flush, the terminal keeping the others. The changed
+ * cells of a row are sent as runs, the cursor going from one run to
+ * the next by the shortest escape sequence, or by sending again the
+ * cells in between, when that is shorter.
+ *
+ * The framebuffer only knows the cells it drew, the others are left
+ * to the console, whose echo writes to the terminal directly, see
+ * fb_release(). The terminal cursor is taken from the console, see
+ * cursor_position(), and left there, in the default colors, so that
+ * the console carries on as if nothing was drawn.
+ */
+
+/*
+ * The attribute of a cell, its ink and background colors, as defined
+ * in console.h, COLOR_RESET being the default color of the terminal.
+ */
+#define FB_ATTR(ink, bg) \
+  (((ink) ? (ink) - BLACK + 1 : 0) | (((bg) ? (bg) - BG_BLACK + 1 : 0) << 4))
+
+#define FB_DEFAULT FB_ATTR(COLOR_RESET, COLOR_RESET)
+
+/*
+ * Forget all the cells, none is drawn.
+ */
+void fb_init(void);
+
+/*
+ * Draw a printable character at the given cell, or a string from
+ * there, clipped at the end of the row, or fill a rectangle.
+ * Cells out of the screen are ignored.
+ */
+void fb_put(int row, int col, char c, uint8_t attr);
+void fb_puts(int row, int col, const char* s, uint8_t attr);
+void fb_fill(int row, int col, int rows, int cols, char c, uint8_t attr);
+
+/*
+ * Give a cell back to the console, the framebuffer forgets it
+ * without sending anything: what the terminal shows there is no
+ * longer drawn, nor overwritten, by the framebuffer.
+ */
+void fb_release(int row, int col);
+
+/*
+ * Send all the cells that are drawn at the next flush, like after
+ * the terminal was cleared or scrolled.
+ */
+void fb_invalidate(void);
+
+/*
+ * Send the cells that changed since the last flush.
+ * Returns the number of bytes sent, 0 if nothing changed.
+ */
+uint32_t fb_flush(void);
+
+#endif /* _FB_H_ */
@@ -0,0 +1,131 @@
+/*
+ * bench-kprintf.c
+ *
+ * Host-side microbenchmark of the number conversion of kprintf.c,
+ * in cycles per conversion (time stamp counter, on x86 hosts) and
+ * nanoseconds, against the former conversion by repeated subtractions.
+ * The former one works on int, so it is only measured on small numbers.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define MAXNBUF (sizeof(intmax_t) * 8 + 1)
+#define CONVERSIONS 100000
+
+char *host_ksprintn(char *nbuf, uintmax_t num, int base, int *lenp, int upper);
+
+static const char hex2ascii_data[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static int mod(int a, int m) {
+  while (a >= m)
+    a -= m;
+  return a;
+}
+
+static int div(int q, int d) {
+  int r = 0;
+  while (q >= d) {
+    q -= d;
+    r++;
+  }
+  return r;
+}
+
+static char *old_ksprintn(char *nbuf, uintmax_t num, int base, int *lenp, int upper) {
+  char *p = nbuf;
+  *p = '\0';
+  do {
+    *++p = hex2ascii_data[mod(num, base)];
+  } while ((num = div(num, base)));
+  if (lenp)
+    *lenp = p - nbuf;
+  return p;
+}
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t seed = 88172645463325252ull;
+static uint64_t rand64(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+static uint64_t values[CONVERSIONS];
+static volatile char sink;
+
+typedef char *(*convert_t)(char *, uintmax_t, int, int *, int);
+
+static void measure(const char *name, convert_t convert, int base, uint64_t max) {
+  char nbuf[MAXNBUF];
+  for (int i = 0; i < CONVERSIONS; i++)
+    values[i] = max == UINT64_MAX ? rand64() : rand64() % (max + 1);
+  double start_ns = now_ns();
+  uint64_t start = cycles();
+  for (int i = 0; i < CONVERSIONS; i++)
+    sink = *convert(nbuf, values[i], base, NULL, 0);
+  uint64_t end = cycles();
+  double end_ns = now_ns();
+  printf("%-4s base %2d, up to %20llu: %8.1f cycles %8.1f ns /conversion\n", name, base,
+         (unsigned long long)max, (double)(end - start) / CONVERSIONS,
+         (end_ns - start_ns) / CONVERSIONS);
+}
+
+/*
+ * Check the conversion against the C library, on the way.
+ */
+static int check(void) {
+  static const int bases[] = { 2, 8, 10, 16, 36 };
+  char nbuf[MAXNBUF], ref[MAXNBUF], out[MAXNBUF];
+  for (int i = 0; i < 1000000; i++) {
+    uint64_t v = rand64() >> (i % 64);
+    for (unsigned b = 0; b < sizeof(bases) / sizeof(bases[0]); b++) {
+      int base = bases[b], len, n = 0;
+      char *p = host_ksprintn(nbuf, v, base, &len, 0);
+      while (*p)
+        out[n++] = *p--;
+      out[n] = '\0';
+      uint64_t x = v;
+      char *r = ref + sizeof(ref) - 1;
+      *r = '\0';
+      do {
+        *--r = hex2ascii_data[x % base];
+      } while (x /= base);
+      if (strcmp(out, r) != 0 || len != n) {
+        printf("ksprintn(%llu, %d) = %s, expected %s\n", (unsigned long long)v, base, out, r);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+int main(void) {
+  if (check())
+    return 1;
+  measure("old", old_ksprintn, 10, 1000000);
+  measure("new", host_ksprintn, 10, 1000000);
+  measure("old", old_ksprintn, 16, 1000000);
+  measure("new", host_ksprintn, 16, 1000000);
+  measure("new", host_ksprintn, 10, UINT32_MAX);
+  measure("new", host_ksprintn, 10, UINT64_MAX);
+  measure("new", host_ksprintn, 16, UINT64_MAX);
+  measure("new", host_ksprintn, 8, UINT64_MAX);
+  measure("new", host_ksprintn, 36, UINT64_MAX);
+  return 0;
+}
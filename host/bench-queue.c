@@ -0,0 +1,65 @@
+/*
+ * bench-queue.c
+ *
+ * Host-side benchmark of the timer queue backends of the event
+ * scheduler (see event-queue.h). It is linked against one backend
+ * at a time, see the bench-queue target in the Makefile.
+ *
+ * The workload mimics our reactions: every timer reposts itself
+ * when it fires, with its own period, some very short, like the
+ * UART poller, some long, like the cursor animation. The clock
+ * jumps to the next eta when nothing is ready, like an idle CPU.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "event-queue.h"
+
+#define DISPATCHES (1 << 18)
+
+static struct event events[MAX_EVENTS];
+static uint32_t periods[MAX_EVENTS];
+
+static uint32_t seed = 12345;
+static uint32_t rand32(void) {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double run(int ntimers) {
+  uint64_t now = 0;
+  evq_init();
+  for (int i = 0; i < ntimers; i++) {
+    // one timer out of 8 is a short poller, the others are longer
+    periods[i] = (i % 8 == 0) ? 1 + rand32() % 4 : 100 + rand32() % 500000;
+    events[i].eta = now + periods[i];
+    events[i].cookie = &periods[i];
+    evq_insert(&events[i]);
+  }
+
+  double start = now_ns();
+  for (int n = 0; n < DISPATCHES;) {
+    struct event* evt = evq_pop_expired(now);
+    if (evt == NULL) {
+      now = evq_next_eta();
+      continue;
+    }
+    evt->eta = now + *(uint32_t*) evt->cookie;
+    evq_insert(evt);
+    n++;
+  }
+  return (now_ns() - start) / DISPATCHES;
+}
+
+int main(void) {
+  static const int sizes[] = { 16, 128, 1024, MAX_EVENTS };
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    printf("%-6s %5d timers: %8.1f ns/dispatch\n", EVENT_QUEUE, sizes[i], run(sizes[i]));
+  return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * bench.c
+ *
+ * Host-side benchmarks of the event scheduler, kprintf, the console
+ * and its framebuffer, run with `make host-bench`. They measure
+ * throughput on the development machine, which says little about the board,
+ * but tells whether a change makes things faster or slower.
+ */
+#include <stdio.h>
+#include <time.h>
+#include "host.h"
+#include "main.h"
+#include "event.h"
+#include "console.h"
+#include "fb.h"
+#include "stars.h"
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Events: a few timers reposting themselves, with different
+ * periods, the clock jumping ahead when nothing is ready.
+ */
+#define EVENTS (1 << 21)
+#define TIMERS 32
+
+static uint32_t dispatched;
+
+static void tick(void* cookie) {
+  dispatched++;
+  event_post(tick, cookie, (uint32_t)(uintptr_t)cookie);
+}
+
+static void bench_events(void) {
+  event_init();
+  dispatched = 0;
+  for (uintptr_t i = 1; i <= TIMERS; i++)
+    event_post(tick, (void*)i, i);
+  double start = now_s();
+  while (dispatched < EVENTS) {
+    if (!event_step())
+      host_now++;
+  }
+  double elapsed = now_s() - start;
+  printf("events:  %10.0f events/s\n", dispatched / elapsed);
+}
+
+/*
+ * The same timers, as periodic events.
+ */
+static void periodic_tick(void* cookie) {
+  dispatched++;
+}
+
+static void bench_periodic(void) {
+  event_init();
+  dispatched = 0;
+  for (uintptr_t i = 1; i <= TIMERS; i++)
+    event_post_periodic(periodic_tick, NULL, i);
+  double start = now_s();
+  while (dispatched < EVENTS) {
+    if (!event_step())
+      host_now++;
+  }
+  double elapsed = now_s() - start;
+  printf("periodic: %9.0f events/s\n", dispatched / elapsed);
+}
+
+/*
+ * Timeouts, restarted much more often than they expire,
+ * like those of a protocol on the UART.
+ */
+#define TIMEOUTS 64
+#define RESTARTS (1 << 21)
+
+static void bench_timeouts(void) {
+  static event_handle_t timeouts[TIMEOUTS];
+  event_init();
+  for (int i = 0; i < TIMEOUTS; i++)
+    timeouts[i] = event_post(tick, (void*)1000, 1000 + i);
+  double start = now_s();
+  for (uint32_t i = 0; i < RESTARTS; i++)
+    event_reschedule(timeouts[i % TIMEOUTS], 1000 + (i & 255));
+  double elapsed = now_s() - start;
+  printf("timeouts: %9.0f restarts/s\n", RESTARTS / elapsed);
+}
+
+/*
+ * Bursts of redraw requests, coalesced into one dispatch per burst.
+ */
+#define REQUESTS (1 << 21)
+#define BURST 16
+
+static void bench_coalesced(void) {
+  event_init();
+  dispatched = 0;
+  double start = now_s();
+  for (uint32_t i = 0; i < REQUESTS; i++) {
+    event_post_coalesced(periodic_tick, (void*)(uintptr_t)(i & 3), 10, EVENT_PRIO_LOW);
+    if ((i % BURST) == BURST - 1) {
+      host_now += 10;
+      while (event_step())
+        ;
+    }
+  }
+  double elapsed = now_s() - start;
+  printf("coalesce: %9.0f requests/s, %u dispatches\n", REQUESTS / elapsed, dispatched);
+}
+
+/*
+ * kprintf: a mix of the formats the console and the reactions use.
+ */
+#define FORMATS (1 << 19)
+
+static void bench_kprintf(void) {
+  char buf[128];
+  uint64_t bytes = 0;
+  double start = now_s();
+  for (uint32_t i = 0; i < FORMATS; i++) {
+    bytes += ksnprintf(buf, sizeof(buf), "%c[%d;%dH", 27, i % NROWS, i % NCOLS);
+    bytes += ksnprintf(buf, sizeof(buf), "%s %u %x", "reaction", i, i * 2654435761u);
+    bytes += ksnprintf(buf, sizeof(buf), "%llu ticks", (unsigned long long)i * 1000003);
+  }
+  double elapsed = now_s() - start;
+  printf("kprintf: %10.0f bytes formatted/s\n", bytes / elapsed);
+}
+
+/*
+ * Console: typed lines, with some backspaces and arrow keys.
+ */
+#define LINES (1 << 16)
+
+static void line_callback(char* line) {
+}
+
+static void bench_console(void) {
+  static const char typed[] = "hello world\b\b\bld\033[D\033[Cagain\r";
+  uint64_t bytes = 0;
+  console_init(line_callback);
+  host_output_bytes = 0;
+  double start = now_s();
+  for (uint32_t i = 0; i < LINES; i++) {
+    for (const char* s = typed; *s; s++)
+      console_echo((uint8_t)*s);
+    bytes += sizeof(typed) - 1;
+    // stay on screen
+    if ((i % NROWS) == NROWS - 1)
+      console_clear();
+  }
+  double elapsed = now_s() - start;
+  printf("console: %10.0f bytes processed/s, %.1f bytes out per byte in\n",
+      bytes / elapsed, (double)host_output_bytes / bytes);
+}
+
+/*
+ * Framebuffer: the cursor animation of main.c, drawn directly as it
+ * was, then through the framebuffer, and a status line of which only
+ * a counter changes, the bytes sent per frame telling the savings.
+ */
+#define FRAMES (1 << 18)
+
+static void bench_fb(void) {
+  static const char glyphs[] = "|/-\\";
+  char status[NCOLS];
+  console_init(line_callback);
+  fb_init();
+  cursor_at(5, 20);
+
+  host_output_bytes = 0;
+  for (uint32_t i = 0; i < FRAMES; i++) {
+    cursor_at(5, 20);
+    console_color((i & 1) ? WHITE : RED);
+    kprintf("%c", glyphs[i & 3]);
+    cursor_at(5, 20);
+    console_color(COLOR_RESET);
+  }
+  double direct = (double)host_output_bytes / FRAMES;
+
+  host_output_bytes = 0;
+  double start = now_s();
+  for (uint32_t i = 0; i < FRAMES; i++) {
+    uint8_t color = (i & 1) ? WHITE : RED;
+    fb_put(5, 20, glyphs[i & 3], FB_ATTR(color, COLOR_RESET));
+    fb_flush();
+  }
+  double elapsed = now_s() - start;
+  printf("fb:      %10.0f frames/s, cursor %.1f bytes/frame, %.1f drawn directly\n",
+      FRAMES / elapsed, (double)host_output_bytes / FRAMES, direct);
+
+  uint64_t fb_bytes = 0, direct_bytes = 0;
+  for (uint32_t i = 0; i < FRAMES; i++) {
+    ksnprintf(status, sizeof(status), "events %10u  late %4u  pool %3u/128", i, i & 63, i & 127);
+    uint64_t bytes = host_output_bytes;
+    fb_puts(NROWS - 1, 0, status, FB_ATTR(BLACK, BG_WHITE));
+    fb_flush();
+    fb_bytes += host_output_bytes - bytes;
+    bytes = host_output_bytes;
+    cursor_at(NROWS - 1, 0);
+    console_color(BLACK);
+    console_color(BG_WHITE);
+    kprintf("%s", status);
+    console_color(COLOR_RESET);
+    cursor_at(5, 20);
+    direct_bytes += host_output_bytes - bytes;
+  }
+  printf("fb:      status line %.1f bytes/frame, %.1f drawn directly\n",
+      (double)fb_bytes / FRAMES, (double)direct_bytes / FRAMES);
+}
+
+/*
+ * Stars: frames rendered, and bytes sent per frame, as their number grows.
+ */
+#define STAR_FRAMES (1 << 12)
+
+static void bench_stars(void) {
+  console_init(line_callback);
+  fb_init();
+  for (uint32_t count = 32; count <= STARS_MAX; count *= 4) {
+    stars_scatter(count, 12345);
+    uint64_t bytes = host_output_bytes;
+    double start = now_s();
+    for (uint32_t i = 0; i < STAR_FRAMES; i++)
+      stars_frame();
+    double elapsed = now_s() - start;
+    printf("stars:   %4u sprites %10.0f frames/s, %6.1f bytes/frame\n", count,
+        STAR_FRAMES / elapsed, (double)(host_output_bytes - bytes) / STAR_FRAMES);
+    stars_clear();
+  }
+}
+
+int main(void) {
+  bench_events();
+  bench_periodic();
+  bench_timeouts();
+  bench_coalesced();
+  bench_kprintf();
+  bench_console();
+  bench_fb();
+  bench_stars();
+  return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * host.h
+ *
+ * The stub backends the portable modules (event.c, console.c and
+ * kprintf.c) are linked with, when built on the development machine,
+ * see the host targets in the Makefile. The UART output is captured
+ * in memory and the clock is simulated, under control of the tests.
+ */
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+
+/*
+ * The simulated time, in ticks, returned by timer_now().
+ * A wfi() jumps it to the armed wake-up time, if any.
+ */
+extern uint64_t host_now;
+
+/*
+ * The bytes sent on the UARTs, the last HOST_OUTPUT_SIZE
+ * ones are kept, NUL-terminated, and all of them are counted.
+ */
+#define HOST_OUTPUT_SIZE 4096
+extern char host_output[HOST_OUTPUT_SIZE];
+extern uint64_t host_output_bytes;
+
+/*
+ * Forget the captured output.
+ */
+void host_output_reset(void);
+
+/*
+ * The receive side of UART0, interrupt-driven, built from uart.c
+ * against a model of the PL011, see uart-host.c: the bytes of s
+ * arrive, a FIFO at a time, each one raising the RX interrupt,
+ * and the reaction reads them with host_uart_receive().
+ */
+void host_uart_rx_enable(void (*react)(void*), void* cookie);
+void host_uart_rx(const char* s);
+int host_uart_receive(uint8_t* b);
+
+#endif /* _HOST_H_ */
@@ -0,0 +1,15 @@
+/*
+ * kprintf-host.c
+ *
+ * Builds kprintf.c on the host, giving access to its static
+ * number conversion, for the benchmarks. The UART output of
+ * kprintf goes nowhere.
+ */
+#include "../kprintf.c"
+
+void uart_send_buffer(void* uart, const uint8_t* buf, uint32_t len) {
+}
+
+char *host_ksprintn(char *nbuf, uintmax_t num, int base, int *lenp, int upper) {
+	return ksprintn(nbuf, num, base, lenp, upper);
+}
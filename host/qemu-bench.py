@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+#
+# qemu-bench.py
+#
+# Boots the kernel headless in QEMU, with UART0 on a pipe, types a
+# scripted keystroke stream and measures, see the bench target of
+# the Makefile:
+#
+#   - the echo latency, the round trip of a single keystroke, from
+#     writing it to reading its echo back, in microseconds of host time;
+#   - the throughput of the console, in bytes per second, between two
+#     timestamps the firmware prints with its `time` command, so that
+#     it is measured in ticks of the board's own clock;
+#   - the cost of an event dispatch and of a ksnprintf, in nanoseconds,
+#     as the firmware's `perf` command times them, with the caches on.
+#
+# The results are checked against the limits in host/bench-thresholds,
+# the exit status is non-zero if any of them is exceeded, or if any of
+# them was never measured, its value being '-': the metric is printed,
+# but the run fails, as it guards nothing, until --update sets it.
+# With --update, the limits are rewritten from this run, with a margin.
+# With --report, the results are only printed, to compare the build
+# profiles, see the profiles target of the Makefile.
+#
+# Usage: qemu-bench.py [--update|--report] [--thresholds FILE] -- QEMU-COMMAND...
+
+import argparse
+import os
+import re
+import select
+import subprocess
+import sys
+import time
+
+# firmware ticks per second, see TIMER_HZ in timer.h
+TIMER_HZ = 1000000
+
+# the echo of a keystroke, a character that no escape sequence
+# of the console or the cursor animation contains
+KEY = b'q'
+KEYS_PER_LINE = 40
+LATENCY_SAMPLES = 400
+
+# the lines typed for the throughput, each one echoed reversed
+LINE = b'the quick brown fox jumps over the lazy dog 0123456789'
+LINES = 200
+
+BOOT_TIMEOUT = 10.0
+TIMEOUT = 30.0
+
+# when updating the thresholds, the margin from the measured values
+MARGIN = 1.5
+
+TIME_RE = re.compile(rb' time=(\d+)\.')
+PERF_RE = re.compile(rb'dispatch +(\d+) ns +\d+ ns.*?ksnprintf +(\d+) ns +\d+ ns', re.S)
+
+
+class Board:
+    def __init__(self, command):
+        self.proc = subprocess.Popen(command, stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE)
+        os.set_blocking(self.proc.stdout.fileno(), False)
+        self.output = b''
+        self.before = b''
+
+    def close(self):
+        self.proc.kill()
+        self.proc.wait()
+
+    def write(self, data):
+        self.proc.stdin.write(data)
+        self.proc.stdin.flush()
+
+    def read(self, timeout):
+        fd = self.proc.stdout.fileno()
+        ready, _, _ = select.select([fd], [], [], timeout)
+        if not ready:
+            return False
+        data = os.read(fd, 65536)
+        if not data:
+            raise RuntimeError('QEMU exited')
+        self.output += data
+        return True
+
+    # Read until the output matches the pattern, a regular expression
+    # or bytes, the output is consumed up to the end of the match,
+    # what came before the match is left in self.before.
+    def expect(self, pattern, timeout=TIMEOUT):
+        if isinstance(pattern, bytes):
+            pattern = re.compile(re.escape(pattern))
+        deadline = time.monotonic() + timeout
+        while True:
+            match = pattern.search(self.output)
+            if match is not None:
+                self.before = self.output[:match.start()]
+                self.output = self.output[match.end():]
+                return match
+            left = deadline - time.monotonic()
+            if left <= 0 or not self.read(left):
+                raise RuntimeError('timeout waiting for %r' % pattern.pattern)
+
+    def timestamp(self, timeout=TIMEOUT):
+        self.write(b'time\r')
+        return int(self.expect(TIME_RE, timeout).group(1))
+
+
+def boot(board):
+    # keep asking for the time until the console answers
+    deadline = time.monotonic() + BOOT_TIMEOUT
+    while time.monotonic() < deadline:
+        try:
+            return board.timestamp(timeout=0.5)
+        except RuntimeError:
+            board.write(b'\r')
+    raise RuntimeError('the kernel did not boot')
+
+
+def percentile(samples, p):
+    samples = sorted(samples)
+    return samples[min(len(samples) - 1, int(len(samples) * p / 100))]
+
+
+def measure_latency(board):
+    samples = []
+    while len(samples) < LATENCY_SAMPLES:
+        for _ in range(KEYS_PER_LINE):
+            start = time.monotonic()
+            board.write(KEY)
+            board.expect(KEY)
+            samples.append((time.monotonic() - start) * 1e6)
+        # end the line, and resynchronize on a timestamp
+        board.write(b'\r')
+        board.timestamp()
+    return {
+        'echo_latency_p50_us': percentile(samples, 50),
+        'echo_latency_p99_us': percentile(samples, 99),
+    }
+
+
+def measure_throughput(board):
+    start = board.timestamp()
+    board.write((LINE + b'\r') * LINES)
+    end = board.timestamp()
+    # every line must have been echoed, reversed
+    echoed = board.before.count(b' -> ' + LINE[::-1])
+    ticks = max(end - start, 1)
+    nbytes = (len(LINE) + 1) * LINES
+    return {
+        'throughput_bytes_per_s': nbytes * TIMER_HZ / ticks,
+        'lines_lost': LINES - echoed,
+    }
+
+
+def measure_perf(board):
+    board.write(b'perf\r')
+    match = board.expect(PERF_RE)
+    return {
+        'dispatch_ns': int(match.group(1)),
+        'ksnprintf_ns': int(match.group(2)),
+    }
+
+
+# The thresholds file holds one limit per line, "metric min|max value",
+# blank lines and lines starting with '#' are ignored, and so are the
+# limits whose value is '-', not set by --update yet.
+def load_thresholds(path):
+    limits = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            metric, kind, value = line.split()
+            if value != '-':
+                limits[metric] = (kind, float(value))
+    return limits
+
+
+def save_thresholds(path, limits, results):
+    lines = []
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 3 and not line.startswith('#') and fields[0] in results:
+                metric, kind = fields[0], fields[1]
+                value = results[metric]
+                if metric == 'lines_lost':
+                    limit = 0
+                elif kind == 'max':
+                    limit = value * MARGIN
+                else:
+                    limit = value / MARGIN
+                line = '%-23s %s %d\n' % (metric, kind, limit)
+            lines.append(line)
+    with open(path, 'w') as f:
+        f.writelines(lines)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--thresholds', default=os.path.join(here, 'bench-thresholds'))
+    parser.add_argument('--update', action='store_true')
+    parser.add_argument('--report', action='store_true')
+    parser.add_argument('qemu', nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+    command = args.qemu[1:] if args.qemu[:1] == ['--'] else args.qemu
+    if not command:
+        parser.error('missing the QEMU command')
+
+    limits = {} if args.report else load_thresholds(args.thresholds)
+    board = Board(command)
+    try:
+        boot(board)
+        results = {}
+        results.update(measure_latency(board))
+        results.update(measure_throughput(board))
+        results.update(measure_perf(board))
+    except RuntimeError as e:
+        print('bench: %s' % e)
+        return 2
+    finally:
+        board.close()
+
+    failed = 0
+    unset = 0
+    for metric, value in results.items():
+        status = ''
+        if metric in limits:
+            kind, limit = limits[metric]
+            ok = value <= limit if kind == 'max' else value >= limit
+            status = '%s %d %s' % (kind, limit, 'ok' if ok else 'REGRESSION')
+            failed += not ok
+        elif not args.report:
+            status = 'NOT MEASURED'
+            unset += 1
+        print('%-24s %12.1f   %s' % (metric, value, status))
+    if unset and not args.update:
+        print('bench: %d limits not measured yet, set them on QEMU with make bench-update' % unset)
+
+    if args.update:
+        save_thresholds(args.thresholds, limits, results)
+        print('thresholds updated in %s' % args.thresholds)
+        return 0
+    return 1 if failed or unset else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,91 @@
+/*
+ * stubs.c
+ *
+ * Host stubs of the UART, the timers and the interrupts, see host.h.
+ */
+#include "host.h"
+#include "uart.h"
+#include "timer.h"
+#include "isr.h"
+
+uint64_t host_now;
+char host_output[HOST_OUTPUT_SIZE];
+uint64_t host_output_bytes;
+static uint32_t output_len;
+static uint64_t wakeup = UINT64_MAX;
+
+void host_output_reset(void) {
+  output_len = 0;
+  host_output[0] = '\0';
+}
+
+/*
+ * UART
+ */
+void uart_send_buffer(void* uart, const uint8_t* buf, uint32_t len) {
+  host_output_bytes += len;
+  for (uint32_t i = 0; i < len; i++) {
+    if (output_len == HOST_OUTPUT_SIZE - 1)
+      output_len = 0;
+    host_output[output_len++] = buf[i];
+  }
+  host_output[output_len] = '\0';
+}
+
+void uart_send(void* uart, uint8_t b) {
+  uart_send_buffer(uart, &b, 1);
+}
+
+uint32_t uart_tx_bytes(void* uart) {
+  return (uint32_t)host_output_bytes;
+}
+
+/*
+ * Timers
+ */
+void timer_init(void) {
+  host_now = 0;
+  wakeup = UINT64_MAX;
+}
+
+uint64_t timer_now(void) {
+  return host_now;
+}
+
+void timer_wakeup_at(uint64_t deadline) {
+  wakeup = deadline;
+}
+
+void timer_wakeup_cancel(void) {
+  wakeup = UINT64_MAX;
+}
+
+/*
+ * Interrupts, there are none.
+ */
+void irqs_setup() {
+}
+
+void irqs_enable() {
+}
+
+void irqs_disable() {
+}
+
+uint32_t irqs_save(void) {
+  return 0;
+}
+
+void irqs_restore(uint32_t flags) {
+}
+
+void wfi(void) {
+  if (wakeup != UINT64_MAX && wakeup > host_now)
+    host_now = wakeup;
+}
+
+void irq_enable(uint32_t irq, void (*callback)(uint32_t, void*), void* cookie) {
+}
+
+void irq_disable(uint32_t irq) {
+}
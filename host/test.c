@@ -0,0 +1,605 @@
+/*
+ * test.c
+ *
+ * Host-side unit tests of the event scheduler, the console, its
+ * framebuffer, the stars, kprintf and the UART reception,
+ * run with `make host-test`, exits non-zero if any check fails.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "host.h"
+#include "main.h"
+#include "uart.h"
+#include "event.h"
+#include "event-queue.h"
+#include "console.h"
+#include "fb.h"
+#include "stars.h"
+
+static int checks;
+static int failures;
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+static void check(int ok, const char* what, const char* file, int line) {
+  checks++;
+  if (!ok) {
+    failures++;
+    printf("%s:%d: check failed: %s\n", file, line, what);
+  }
+}
+
+/*
+ * kprintf
+ */
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+
+static int check_format(const char* expected, const char* fmt, ...) {
+  char buf[128];
+  va_list ap;
+  va_start(ap, fmt);
+  int len = kvsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (strcmp(buf, expected) != 0 || len != (int)strlen(expected)) {
+    printf("format \"%s\": got \"%s\" (%d), expected \"%s\"\n", fmt, buf, len, expected);
+    return 0;
+  }
+  return 1;
+}
+
+static void test_kprintf(void) {
+  char buf[8];
+
+  CHECK(check_format("42", "%d", 42));
+  CHECK(check_format("-42", "%d", -42));
+  CHECK(check_format("4294967295", "%u", 4294967295u));
+  CHECK(check_format("18446744073709551615", "%llu", 18446744073709551615ull));
+  CHECK(check_format("-9223372036854775808", "%lld", (long long)(-9223372036854775807ll - 1)));
+  CHECK(check_format("ff FF 0xff", "%x %X %#x", 255, 255, 255));
+  CHECK(check_format("777", "%o", 0777));
+  CHECK(check_format("00001234", "%08d", 1234));
+  CHECK(check_format("ab   |", "%-5s|", "ab"));
+  CHECK(check_format("\033[3;4H", "%c[%d;%dH", 27, 3, 4));
+  CHECK(check_format("reg=3<BITTWO,BITONE>", "reg=%b", 3, "\10\2BITTWO\1BITONE"));
+
+  // truncation, the length of the whole output is returned
+  CHECK(ksnprintf(buf, sizeof(buf), "%s", "0123456789") == 10);
+  CHECK(strcmp(buf, "0123456") == 0);
+
+  // kprintf goes to the UART
+  host_output_reset();
+  kprintf("x=%d\n", 7);
+  CHECK(strcmp(host_output, "x=7\n") == 0);
+}
+
+/*
+ * Event scheduler
+ */
+static char trace[MAX_EVENTS + 16];
+static int ntrace;
+
+static void record(void* cookie) {
+  trace[ntrace++] = *(char*)cookie;
+  trace[ntrace] = '\0';
+}
+
+static void repost(void* cookie) {
+  record(cookie);
+  if (ntrace < 3)
+    event_post(repost, cookie, 10);
+}
+
+static event_handle_t self;
+
+static void cancel_self(void* cookie) {
+  record(cookie);
+  if (ntrace == 3)
+    event_cancel(self);
+}
+
+static void move_self(void* cookie) {
+  record(cookie);
+  event_reschedule(self, 1000);
+}
+
+static void cancel_other(void* cookie) {
+  event_cancel(self);
+}
+
+static void run_until(uint64_t time) {
+  while (host_now <= time) {
+    while (event_step())
+      ;
+    host_now++;
+  }
+}
+
+static void test_event(void) {
+  static char a = 'a', b = 'b', c = 'c';
+  struct event_pool_info info;
+
+  event_init();
+  ntrace = 0;
+  event_post(record, &c, 30);
+  event_post(record, &a, 10);
+  event_post(record, &b, 20);
+  CHECK(event_step() == 0);
+  run_until(15);
+  CHECK(strcmp(trace, "a") == 0);
+  run_until(100);
+  CHECK(strcmp(trace, "abc") == 0);
+
+  // events are not run before their eta
+  event_init();
+  ntrace = 0;
+  event_post(repost, &a, 5);
+  host_now = 4;
+  CHECK(event_step() == 0);
+  host_now = 5;
+  CHECK(event_step() == 1);
+  run_until(14);
+  CHECK(ntrace == 1);
+  run_until(100);
+  CHECK(strcmp(trace, "aaa") == 0);
+
+  // ready events run by priority, then by eta
+  event_init();
+  ntrace = 0;
+  event_post_prio(record, &c, 1, EVENT_PRIO_LOW);
+  event_post_prio(record, &b, 2, EVENT_PRIO_NORMAL);
+  event_post_prio(record, &a, 3, EVENT_PRIO_HIGH);
+  event_post_prio(record, &b, 1, EVENT_PRIO_NORMAL);
+  host_now = 10;
+  while (event_step())
+    ;
+  CHECK(strcmp(trace, "abbc") == 0);
+
+  // out of range priorities are clamped to the nearest class
+  event_init();
+  ntrace = 0;
+  event_post_prio(record, &a, 1, EVENT_PRIO_LOW);
+  event_post_prio(record, &b, 2, EVENT_PRIOS);
+  event_post_prio(record, &c, 3, -1);
+  event_post_from_isr(record, &b, 4, 1000);
+  event_post_coalesced(record, &a, 5, -1000);
+  host_now = 10;
+  while (event_step())
+    ;
+  CHECK(strcmp(trace, "caabb") == 0);
+
+  // events posted by handlers go through the inbox, in order
+  event_init();
+  ntrace = 0;
+  event_post_from_isr(record, &a, 0, EVENT_PRIO_NORMAL);
+  event_post_from_isr(record, &b, 0, EVENT_PRIO_NORMAL);
+  event_post_from_isr(record, &c, 5, EVENT_PRIO_NORMAL);
+  run_until(10);
+  CHECK(strcmp(trace, "abc") == 0);
+
+  // periodic events keep their phase, whenever they actually run
+  event_init();
+  ntrace = 0;
+  event_handle_t tick = event_post_periodic(record, &a, 10);
+  host_now = 13;
+  CHECK(event_step() == 1);
+  host_now = 19;
+  CHECK(event_step() == 0);
+  host_now = 20;
+  CHECK(event_step() == 1);
+  // missed periods are skipped, the late one still runs
+  host_now = 55;
+  CHECK(event_step() == 1);
+  CHECK(event_step() == 0);
+  host_now = 60;
+  CHECK(event_step() == 1);
+  CHECK(ntrace == 4);
+
+  // cancelled, whether pending, expired or ready
+  event_cancel(tick);
+  run_until(200);
+  CHECK(ntrace == 4);
+  tick = event_post_periodic(record, &b, 10);
+  host_now += 20;
+  event_cancel(tick);
+  CHECK(event_step() == 0);
+
+  tick = event_post_periodic(record, &b, 10);
+  self = tick;
+  event_post_prio(cancel_other, NULL, 10, EVENT_PRIO_HIGH);
+  host_now += 10;
+  CHECK(event_step() == 1);
+  CHECK(event_step() == 0);
+
+  // or from its own reaction
+  ntrace = 0;
+  self = event_post_periodic(cancel_self, &c, 5);
+  run_until(host_now + 100);
+  CHECK(strcmp(trace, "ccc") == 0);
+
+  // handles go stale once their event ran or was cancelled
+  event_init();
+  ntrace = 0;
+  event_handle_t timeout = event_post(record, &a, 10);
+  CHECK(timeout != EVENT_NONE);
+  CHECK(event_reschedule(timeout, 20) == 1);
+  host_now = 15;
+  CHECK(event_step() == 0);
+  host_now = 20;
+  CHECK(event_step() == 1);
+  CHECK(event_cancel(timeout) == 0);
+  CHECK(event_reschedule(timeout, 5) == 0);
+  timeout = event_post(record, &b, 10);
+  event_handle_t other = event_post(record, &c, 10);
+  CHECK(event_cancel(timeout) == 1);
+  CHECK(event_cancel(timeout) == 0);
+  // the slot is reused, the old handle does not designate the new event,
+  // due after the other one, the backends not ordering equal etas alike
+  event_handle_t reused = event_post(record, &b, 15);
+  CHECK(event_cancel(timeout) == 0);
+  run_until(40);
+  CHECK(strcmp(trace, "acb") == 0);
+  CHECK(event_cancel(other) == 0 && event_cancel(reused) == 0);
+
+  // a periodic event may be moved, from its own reaction too
+  ntrace = 0;
+  self = event_post_periodic(move_self, &a, 10);
+  run_until(host_now + 100);
+  CHECK(ntrace == 1);
+  CHECK(event_reschedule(self, 1) == 1);
+  run_until(host_now + 1);
+  CHECK(ntrace == 2);
+  CHECK(event_cancel(self) == 1);
+
+  // coalesced posts of the same pending work run once, at the earliest eta
+  event_init();
+  ntrace = 0;
+  event_handle_t redraw = event_post_coalesced(record, &a, 50, EVENT_PRIO_LOW);
+  for (int i = 0; i < 20; i++)
+    CHECK(event_post_coalesced(record, &a, 30 + i, EVENT_PRIO_LOW) == redraw);
+  CHECK(event_post_coalesced(record, &b, 40, EVENT_PRIO_LOW) != redraw);
+  event_pool_info(&info);
+  CHECK(info.used == 2);
+  run_until(30);
+  CHECK(strcmp(trace, "a") == 0);
+  // once dispatched, the next post is a new event
+  CHECK(event_post_coalesced(record, &a, 1, EVENT_PRIO_LOW) != redraw);
+  run_until(100);
+  CHECK(strcmp(trace, "aab") == 0);
+  // cancelled events leave the index
+  redraw = event_post_coalesced(record, &c, 10, EVENT_PRIO_LOW);
+  CHECK(event_cancel(redraw) == 1);
+  CHECK(event_post_coalesced(record, &c, 10, EVENT_PRIO_LOW) != redraw);
+
+  // the pool holds EVENT_POOL_EVENTS events, more are not posted
+  event_init();
+  ntrace = 0;
+  for (int i = 0; i < EVENT_POOL_EVENTS + 10; i++)
+    event_post(record, &a, 1);
+  event_pool_info(&info);
+  CHECK(info.size == EVENT_POOL_EVENTS && info.used == EVENT_POOL_EVENTS && info.failed == 10);
+  run_until(host_now + 10);
+  CHECK(ntrace == EVENT_POOL_EVENTS);
+  event_pool_info(&info);
+  CHECK(info.used == 0 && info.high_water == EVENT_POOL_EVENTS);
+
+  // overflow policies
+  event_init();
+  ntrace = 0;
+  for (int i = 0; i < EVENT_POOL_EVENTS - 1; i++)
+    event_post(record, &a, 10);
+  event_handle_t victim = event_post_prio(record, &c, 20, EVENT_PRIO_LOW);
+  CHECK(event_post_policy(record, &a, 5, EVENT_PRIO_LOW, EVENT_OVERFLOW_EVICT) == EVENT_NONE);
+  CHECK(event_post_policy(record, &b, 5, EVENT_PRIO_HIGH, EVENT_OVERFLOW_EVICT) != EVENT_NONE);
+  // the block of the victim was reused, its handle is stale
+  CHECK(event_cancel(victim) == 0);
+  event_pool_info(&info);
+  CHECK(info.used == EVENT_POOL_EVENTS && info.evicted == 1 && info.failed == 1);
+  event_handle_t merged = event_post_policy(record, &b, 1, EVENT_PRIO_HIGH, EVENT_OVERFLOW_COALESCE);
+  CHECK(merged != EVENT_NONE);
+  CHECK(event_post_policy(record, &c, 1, EVENT_PRIO_HIGH, EVENT_OVERFLOW_COALESCE) == EVENT_NONE);
+  event_pool_info(&info);
+  CHECK(info.evicted == 1 && info.coalesced == 1 && info.failed == 2);
+  // the merged post kept the earlier eta
+  run_until(host_now + 1);
+  CHECK(strcmp(trace, "b") == 0);
+  run_until(host_now + 100);
+  CHECK(ntrace == EVENT_POOL_EVENTS && strchr(trace, 'c') == NULL);
+
+  // a coalesced post merged, on overflow, into a plain post is not
+  // indexed with it, the next coalesced post queues its own event
+  event_init();
+  event_handle_t filler = event_post(record, &a, 10);
+  for (int i = 0; i < EVENT_POOL_EVENTS - 2; i++)
+    event_post(record, &a, 10);
+  event_handle_t plain = event_post(record, &b, 10);
+  CHECK(event_post_coalesced(record, &b, 10, EVENT_PRIO_LOW) == plain);
+  CHECK(event_cancel(filler) == 1);
+  CHECK(event_post_coalesced(record, &b, 10, EVENT_PRIO_LOW) != plain);
+  run_until(host_now + 100);
+
+  // the pool of the target grows, up to MAX_EVENTS
+  static struct event more[MAX_EVENTS];
+  CHECK(EVENT_POOL_EVENTS < MAX_EVENTS);
+  CHECK(event_pool_grow(more, sizeof(more)) == MAX_EVENTS - EVENT_POOL_EVENTS);
+  event_pool_info(&info);
+  CHECK(info.size == MAX_EVENTS);
+  ntrace = 0;
+  int posted = 0;
+  for (int i = 0; i < MAX_EVENTS; i++)
+    posted += (event_post(record, &a, 1) != EVENT_NONE);
+  CHECK(posted == MAX_EVENTS);
+  CHECK(event_post(record, &a, 1) == EVENT_NONE);
+  run_until(host_now + 10);
+  CHECK(ntrace == MAX_EVENTS);
+}
+
+/*
+ * Console
+ */
+static char line[128];
+static int nlines;
+
+static void line_callback(char* str) {
+  strcpy(line, str);
+  nlines++;
+}
+
+static void echo_string(const char* s) {
+  while (*s)
+    console_echo((uint8_t)*s++);
+}
+
+static void test_console(void) {
+  int row, col;
+
+  console_init(line_callback);
+  host_output_reset();
+  nlines = 0;
+  echo_string("hello\r");
+  CHECK(nlines == 1);
+  CHECK(strcmp(line, "hello") == 0);
+  CHECK(strstr(host_output, "hello") != NULL);
+  cursor_position(&row, &col);
+  CHECK(row == 1 && col == 0);
+
+  // backspace removes the last character
+  echo_string("abx\b\177c\r");
+  CHECK(strcmp(line, "ac") == 0);
+
+  // arrow keys move the cursor, and are not part of the line
+  echo_string("\033[A\033[Cz\r");
+  CHECK(strcmp(line, "z") == 0);
+
+  // control characters are ignored
+  echo_string("\001q\002\r");
+  CHECK(strcmp(line, "q") == 0);
+}
+
+/*
+ * The console keeps track of the terminal, sending the shortest
+ * sequences, until something else is sent.
+ */
+static int check_output(const char* expected) {
+  int ok = strcmp(host_output, expected) == 0;
+  host_output_reset();
+  return ok;
+}
+
+static void test_terminal(void) {
+  console_init(line_callback);
+  host_output_reset();
+  cursor_at(0, 0);
+  CHECK(check_output(""));
+  cursor_at(0, 1);
+  CHECK(check_output("\033[C"));
+  cursor_at(0, 0);
+  CHECK(check_output("\b"));
+  cursor_at(3, 5);
+  CHECK(check_output("\033[4;6H"));
+  cursor_at(3, 1);
+  CHECK(check_output("\033[4D"));
+  cursor_at(3, 20);
+  CHECK(check_output("\033[19C"));
+  cursor_at(3, 1);
+  CHECK(check_output("\r\033[C"));
+  cursor_at(4, 0);
+  CHECK(check_output("\r\n"));
+  cursor_at(NROWS + 3, 0);
+  CHECK(check_output("\033[24H"));
+  cursor_at(2, 7);
+
+  // colors
+  host_output_reset();
+  console_color(RED);
+  console_color(RED);
+  CHECK(check_output("\033[31m"));
+  console_colors(RED, BG_BLUE);
+  CHECK(check_output("\033[44m"));
+  console_colors(COLOR_RESET, BG_BLUE);
+  CHECK(check_output("\033[0;44m"));
+  console_color(COLOR_RESET);
+  CHECK(check_output("\033[0m"));
+
+  // backspace
+  echo_string("ab\b");
+  CHECK(check_output("ab\b \b"));
+
+  // something else was sent, the next move is absolute
+  uint32_t sent = uart_tx_bytes(UART0);
+  kprintf("x");
+  CHECK(uart_tx_bytes(UART0) == sent + 1);
+  host_output_reset();
+  cursor_at(2, 8);
+  CHECK(check_output("\033[3;9H"));
+  console_color(COLOR_RESET);
+  CHECK(check_output("\033[0m"));
+  echo_string("\r");
+}
+
+/*
+ * The framebuffer, the console's cursor being at (0,0) unless moved,
+ * each flush sends the changed cells, then goes back there.
+ */
+static void test_fb(void) {
+  console_init(line_callback);
+  fb_init();
+  host_output_reset();
+  CHECK(fb_flush() == 0);
+  CHECK(host_output[0] == '\0');
+
+  // the cursor is already there, and goes back by a backspace
+  fb_put(0, 0, 'x', FB_DEFAULT);
+  CHECK(fb_flush() == 2);
+  CHECK(strcmp(host_output, "x\b") == 0);
+
+  // drawing what is already drawn sends nothing
+  fb_put(0, 0, 'x', FB_DEFAULT);
+  CHECK(fb_flush() == 0);
+
+  // a cell not drawn is skipped over, a drawn one is sent again
+  host_output_reset();
+  fb_put(2, 10, 'a', FB_DEFAULT);
+  fb_put(2, 12, 'b', FB_DEFAULT);
+  fb_flush();
+  CHECK(strcmp(host_output, "\033[3;11Ha\033[Cb\033[H") == 0);
+  host_output_reset();
+  fb_puts(2, 11, "c", FB_DEFAULT);
+  fb_put(2, 13, 'd', FB_DEFAULT);
+  fb_flush();
+  CHECK(strcmp(host_output, "\033[3;12Hcbd\033[H") == 0);
+
+  // colors, reset for the console
+  host_output_reset();
+  fb_put(1, 0, 'r', FB_ATTR(RED, COLOR_RESET));
+  fb_flush();
+  CHECK(strcmp(host_output, "\r\n\033[31mr\033[0m\033[H") == 0);
+  host_output_reset();
+  fb_fill(1, 0, 1, 2, 'r', FB_ATTR(RED, BG_BLUE));
+  fb_flush();
+  CHECK(strcmp(host_output, "\r\n\033[31;44mrr\033[0m\033[H") == 0);
+
+  // a released cell is forgotten, and drawn again as new
+  fb_release(1, 0);
+  CHECK(fb_flush() == 0);
+  host_output_reset();
+  fb_put(1, 0, 'r', FB_ATTR(RED, BG_BLUE));
+  fb_flush();
+  CHECK(strcmp(host_output, "\r\n\033[31;44mr\033[0m\033[H") == 0);
+
+  // everything drawn is sent again after an invalidation
+  fb_invalidate();
+  host_output_reset();
+  CHECK(fb_flush() > 0);
+  CHECK(strstr(host_output, "acbd") != NULL);
+  CHECK(strstr(host_output, "rr") != NULL);
+
+  // backward, or from the start of the row, whichever is shorter
+  echo_string("0123456789");
+  host_output_reset();
+  fb_put(0, 2, 'Z', FB_DEFAULT);
+  fb_flush();
+  CHECK(strcmp(host_output, "\033[8DZ\033[7C") == 0);
+  host_output_reset();
+  fb_put(0, 0, 'Y', FB_DEFAULT);
+  fb_flush();
+  CHECK(strcmp(host_output, "\rY\033[9C") == 0);
+  echo_string("\r");
+
+  // the bytes sent by the console before the cells are counted too
+  console_color(RED);
+  host_output_reset();
+  fb_put(0, 1, 'W', FB_DEFAULT);
+  CHECK(fb_flush() == strlen(host_output));
+  CHECK(strcmp(host_output, "\033[0m\033[1;2HW\r\n") == 0);
+}
+
+/*
+ * The stars, each one moving every delay frames, one column to
+ * the right, wrapping around, its glyph cycling.
+ */
+static void test_stars(void) {
+  struct star s = { .delay = 2, .line = 3, .col = NCOLS - 1, .index = 0,
+      .charac = { 'a', 'b', 0 }, .display = TRUE };
+  struct star t = { .delay = 1, .line = 5, .col = 0, .index = 1,
+      .charac = { 'x', 'y', 'z', 0 }, .display = TRUE };
+
+  console_init(line_callback);
+  fb_init();
+  moveStar(&s);
+  CHECK(s.col == 0 && s.index == 1);
+  moveStar(&s);
+  CHECK(s.col == 1 && s.index == 0);
+  fb_init();
+
+  s.col = NCOLS - 1;
+  CHECK(stars_add(&s) == 0);
+  CHECK(stars_add(&t) == 1);
+  host_output_reset();
+  // the first frame draws both, t moving
+  CHECK(stars_frame() > 0);
+  CHECK(strstr(host_output, "z") != NULL);
+  CHECK(strchr(host_output, 'a') != NULL);
+  // then s moves, wrapping around, and t moves again
+  host_output_reset();
+  stars_frame();
+  CHECK(strchr(host_output, 'b') != NULL && strchr(host_output, 'x') != NULL);
+  // nothing drawn once cleared
+  stars_clear();
+  host_output_reset();
+  CHECK(stars_frame() == 0);
+
+  CHECK(stars_scatter(STARS_MAX + 1, 1) == STARS_MAX);
+  stars_clear();
+}
+
+/*
+ * The interrupt-driven reception of the UART, its handler posting
+ * a reaction per batch of bytes.
+ */
+static char received[64];
+static int nreceived;
+
+static void receive(void* cookie) {
+  uint8_t b;
+  while (host_uart_receive(&b) && nreceived < (int)sizeof(received) - 1)
+    received[nreceived++] = b;
+  received[nreceived] = '\0';
+}
+
+static void test_uart(void) {
+  struct event_pool_info info;
+  static char a = 'a';
+
+  event_init();
+  host_uart_rx_enable(receive, NULL);
+  nreceived = 0;
+  host_uart_rx("hello");
+  run_until(host_now + 1);
+  CHECK(strcmp(received, "hello") == 0);
+
+  // a post lost on an exhausted pool, the next batch posts again
+  ntrace = 0;
+  while (event_post(record, &a, 10) != EVENT_NONE)
+    ;
+  host_uart_rx("ab");
+  event_pool_info(&info);
+  CHECK(info.lost == 1);
+  run_until(host_now + 10);
+  CHECK(strcmp(received, "hello") == 0);
+  host_uart_rx("c");
+  run_until(host_now + 1);
+  CHECK(strcmp(received, "helloabc") == 0);
+}
+
+int main(void) {
+  test_kprintf();
+  test_event();
+  test_console();
+  test_terminal();
+  test_fb();
+  test_stars();
+  test_uart();
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures != 0;
+}
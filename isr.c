@@ -0,0 +1,96 @@
+#include "main.h"
+#include "isr.h"
+#include "isr-mmio.h"
+
+#define VIC (void*)VIC_BASE_ADDR
+
+/*
+ * Implemented in assembly, see irq.S
+ */
+extern void _irqs_setup(void);
+extern void _irqs_enable(void);
+extern void _irqs_disable(void);
+extern uint32_t _irqs_save(void);
+extern void _irqs_restore(uint32_t flags);
+extern void _wfi(void);
+
+/*
+ * One handler per interrupt line of the VIC.
+ */
+struct handler {
+  void (*callback)(uint32_t irq, void* cookie);
+  void* cookie;
+};
+static struct handler handlers[NIRQS];
+
+/*
+ * See "isr.h"
+ */
+void irqs_setup() {
+  _irqs_setup();
+  for (int i = 0; i < NIRQS; i++) {
+    handlers[i].callback = NULL;
+    handlers[i].cookie = NULL;
+  }
+  // all lines are IRQs, not FIQs, and all start disabled
+  mmio_write32(VIC, VICINTSELECT, 0);
+  mmio_write32(VIC, VICINTCLEAR, 0xFFFFFFFF);
+}
+
+void irqs_enable() {
+  _irqs_enable();
+}
+
+void irqs_disable() {
+  _irqs_disable();
+}
+
+uint32_t irqs_save(void) {
+  return _irqs_save();
+}
+
+void irqs_restore(uint32_t flags) {
+  _irqs_restore(flags);
+}
+
+void wfi(void) {
+  _wfi();
+}
+
+/*
+ * See "isr.h"
+ */
+void irq_enable(uint32_t irq, void (*callback)(uint32_t, void*), void* cookie) {
+  handlers[irq].callback = callback;
+  handlers[irq].cookie = cookie;
+  mmio_write32(VIC, VICINTENABLE, 1 << irq);
+}
+
+/*
+ * See "isr.h"
+ */
+void irq_disable(uint32_t irq) {
+  mmio_write32(VIC, VICINTCLEAR, 1 << irq);
+  handlers[irq].callback = NULL;
+  handlers[irq].cookie = NULL;
+}
+
+/*
+ * Upcalled from the IRQ vector (see exception.s), in IRQ mode,
+ * on the IRQ stack, with interrupts disabled at the processor.
+ * Dispatches every pending line to its handler, which must clear
+ * the interrupt at the device, since the VIC lines are level-sensitive.
+ */
+void isr(void) {
+  uint32_t status = mmio_read32(VIC, VICIRQSTATUS);
+  while (status != 0) {
+    uint32_t irq = __builtin_ctz(status);
+    status &= status - 1;
+    struct handler* handler = &handlers[irq];
+    if (handler->callback != NULL)
+      handler->callback(irq, handler->cookie);
+    else
+      // nobody to clear it, mask it or it would fire forever
+      mmio_write32(VIC, VICINTCLEAR, 1 << irq);
+  }
+}
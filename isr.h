@@ -22,6 +22,8 @@
 #ifndef ISR_H_
 #define ISR_H_
 
+#include <stdint.h>
+
 /*
  * Versatile Application Baseboard for ARM926EJ-S User Guide HBI-0118
  *   (https://developer.arm.com/documentation/dui0225/latest)
@@ -54,29 +56,44 @@
  *       TIMER(0&1) IRQ = 4
  */
 #define TIMER3_IRQ 5
-#define TIMER3_IRQ_MASK (1<<TIMER3_IRQ_MASK)
+#define TIMER3_IRQ_MASK (1<<TIMER3_IRQ)
 
 #define TIMER2_IRQ 5
-#define TIMER2_IRQ_MASK (1<<TIMER2_IRQ_MASK)
+#define TIMER2_IRQ_MASK (1<<TIMER2_IRQ)
 
 #define TIMER1_IRQ 4
-#define TIMER1_IRQ_MASK (1<<TIMER1_IRQ_MASK)
+#define TIMER1_IRQ_MASK (1<<TIMER1_IRQ)
 
 #define TIMER0_IRQ 4
-#define TIMER0_IRQ_MASK (1<<TIMER0_IRQ_MASK)
+#define TIMER0_IRQ_MASK (1<<TIMER0_IRQ)
 
 
 /*
  * VIC behavior:
+ *   - irqs_setup sets up the IRQ stack and starts with
+ *     all the lines disabled, and no handlers.
+ *   - irqs_enable and irqs_disable enable and disable
+ *     interrupts at the processor only.
  */
 void irqs_setup();
 void irqs_enable();
 void irqs_disable();
 void wfi(void);
 
+/*
+ * Critical sections: irqs_save disables interrupts at
+ * the processor and returns the previous state, which
+ * irqs_restore puts back. They nest, and may be used
+ * in interrupt handlers as well.
+ */
+uint32_t irqs_save(void);
+void irqs_restore(uint32_t flags);
+
 /*
  * Enable the given interrupt,
- * like UART0_IRQ
+ * like UART0_IRQ, the callback is called from
+ * the IRQ handler, with the interrupt number and the
+ * given cookie, it must clear the interrupt at the device.
  */
 void irq_enable(uint32_t irq,void(*callback)(uint32_t,void*),void*cookie);
 
@@ -36,6 +36,7 @@
 
 #include "main.h"
 #include "uart.h"
+#include "prof.h"
 
 
 #define va_list __builtin_va_list
@@ -45,9 +46,44 @@
 
 int kvprintf(char const *fmt, void (*func)(uint8_t, void*), void *arg, int radix, va_list ap);
 
+/*
+ * kprintf formats into a buffer on the stack, sent with a single
+ * uart_send_buffer once the whole output is rendered, rather than
+ * going through the UART one character at a time. Longer outputs
+ * are sent each time the buffer fills up.
+ */
+#define KPRINTF_BUFSIZE 128
+
+struct kbuf {
+	uint8_t data[KPRINTF_BUFSIZE];
+	uint32_t len;
+};
+
 static
 void kputchar(uint8_t code, void *arg) {
-	uart_send(UART0,code);
+	struct kbuf *kb = (struct kbuf *) arg;
+	kb->data[kb->len++] = code;
+	if (kb->len == KPRINTF_BUFSIZE) {
+		uart_send_buffer(UART0, kb->data, kb->len);
+		kb->len = 0;
+	}
+}
+
+/*
+ * ksnprintf renders into the caller's buffer, truncating
+ * the output, but always terminating it with a '\0'.
+ */
+struct ksbuf {
+	char *data;
+	size_t size;
+	size_t len;
+};
+
+static
+void ksputchar(uint8_t code, void *arg) {
+	struct ksbuf *ks = (struct ksbuf *) arg;
+	if (ks->len + 1 < ks->size)
+		ks->data[ks->len++] = code;
 }
 
 /**********************************************************************************************
@@ -55,12 +91,43 @@ void kputchar(uint8_t code, void *arg) {
  * AND EVEN SO, ASK FIRST...
  **********************************************************************************************/
 
+PROF_SCOPE(kvprintf_scope, "kvprintf");
+
 void kprintf(const char *fmt, ...) {
   /* http://www.pagetable.com/?p=298 */
+  struct kbuf kb;
+  va_list ap;
+  kb.len = 0;
+  va_start(ap, fmt);
+  prof_begin(&kvprintf_scope);
+  kvprintf(fmt, kputchar, &kb, 10, ap);
+  prof_end(&kvprintf_scope);
+  va_end(ap);
+  if (kb.len > 0)
+    uart_send_buffer(UART0, kb.data, kb.len);
+}
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+  struct ksbuf ks;
+  int len;
+  ks.data = buf;
+  ks.size = size;
+  ks.len = 0;
+  prof_begin(&kvprintf_scope);
+  len = kvprintf(fmt, ksputchar, &ks, 10, ap);
+  prof_end(&kvprintf_scope);
+  if (size > 0)
+    buf[ks.len] = '\0';
+  return len;
+}
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...) {
   va_list ap;
+  int len;
   va_start(ap, fmt);
-  kvprintf(fmt, kputchar, NULL, 10, ap);
+  len = kvsnprintf(buf, size, fmt, ap);
   va_end(ap);
+  return len;
 }
 
 typedef unsigned char u_char;
@@ -69,7 +136,6 @@ typedef unsigned long u_long;
 typedef unsigned short u_short;
 typedef unsigned long long u_quad_t;
 typedef long long quad_t;
-typedef unsigned int size_t;
 typedef int ssize_t;
 
 #define NBBY    8               /* number of bits in a byte */
@@ -87,19 +153,53 @@ static size_t strlen(const char *s) {
 /* Max number conversion buffer length: a u_quad_t in base 2, plus NUL byte. */
 #define MAXNBUF (sizeof(intmax_t) * NBBY + 1)
 
-static int mod(int a, int m) {
-	while (a >= m)
-		a -= m;
-	return a;
+/*
+ * Two-digit decimal strings, from "00" to "99".
+ */
+static char const dec2ascii_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/*
+ * We have no hardware divider, and libgcc, linked for the helpers
+ * the compiler may call, only divides by a loop, so divisions are
+ * done by hand, and rather than dividing by repeated subtractions,
+ * which costs millions of iterations on large numbers, the number
+ * is converted according to its base:
+ *   - for powers of two, digits are extracted by shifts and masks,
+ *   - for base 10, by multiplying by the reciprocal of 10, or of
+ *     100 to get two digits at once, while the number fits in
+ *     32 bits, through shifts and adds for 64-bit numbers
+ *     (Hacker's Delight, 10-21),
+ *   - for any other base, by a binary long division.
+ */
+static uintmax_t divu10(uintmax_t n) {
+	uintmax_t q, r;
+	q = (n >> 1) + (n >> 2);
+	q += q >> 4;
+	q += q >> 8;
+	q += q >> 16;
+	q += q >> 32;
+	q >>= 3;
+	r = n - ((q << 3) + (q << 1));
+	return q + (r > 9);
 }
 
-static int div(int q, int d) {
-	int r = 0;
-	while (q >= d) {
-		q -= d;
-		r++;
+uintmax_t divmodu(uintmax_t n, u_int d, u_int *rem) {
+	uintmax_t q = 0;
+	u_int r = 0;
+	int i;
+	for (i = sizeof(uintmax_t) * NBBY - 1; i >= 0; i--) {
+		r = (r << 1) | (u_int)((n >> i) & 1);
+		q <<= 1;
+		if (r >= d) {
+			r -= d;
+			q |= 1;
+		}
 	}
-	return r;
+	*rem = r;
+	return q;
 }
 
 /*
@@ -111,13 +211,43 @@ static int div(int q, int d) {
 static char *
 ksprintn(char *nbuf, uintmax_t num, int base, int *lenp, int upper) {
 	char *p, c;
+	u_int d;
 
 	p = nbuf;
 	*p = '\0';
-	do {
-		c = hex2ascii(mod(num, base)); // num % base);
-		*++p = upper ? toupper(c) : c;
-	} while (num = div(num, base)); // (num /= base);
+	if ((base & (base - 1)) == 0) {
+		int shift = __builtin_ctz(base);
+		do {
+			c = hex2ascii(num & (base - 1));
+			*++p = upper ? toupper(c) : c;
+		} while (num >>= shift);
+	} else if (base == 10) {
+		uint32_t n32, q32;
+		while (num > 0xFFFFFFFF) {
+			uintmax_t q = divu10(num);
+			*++p = '0' + (char)(num - ((q << 3) + (q << 1)));
+			num = q;
+		}
+		n32 = (uint32_t)num;
+		while (n32 >= 100) {
+			q32 = (uint32_t)(((uint64_t)n32 * 0x51EB851F) >> 37); // n32 / 100
+			d = n32 - q32 * 100;
+			*++p = dec2ascii_pairs[2 * d + 1];
+			*++p = dec2ascii_pairs[2 * d];
+			n32 = q32;
+		}
+		if (n32 >= 10) {
+			*++p = dec2ascii_pairs[2 * n32 + 1];
+			*++p = dec2ascii_pairs[2 * n32];
+		} else
+			*++p = '0' + n32;
+	} else {
+		do {
+			num = divmodu(num, base, &d);
+			c = hex2ascii(d);
+			*++p = upper ? toupper(c) : c;
+		} while (num);
+	}
 	if (lenp)
 		*lenp = p - nbuf;
 	return (p);
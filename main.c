@@ -1,17 +1,25 @@
 #include "main.h"
 #include "uart.h"
 #include "console.h"
+#include "fb.h"
 #include "event.h"
+#include "timer.h"
+#include "isr.h"
+#include "prof.h"
+#include "perf.h"
+#include "stars.h"
 
 
 /*
- * Define ECHO_ZZZ to have a periodic reminder that this code is polling
- * the UART, actively. This means the processor is running continuously.
- * Polling is of course not the way to go, the processor should halt in
- * a low-power state and wake-up only to handle an interrupt from the UART.
- * But this would require setting up interrupts...
+ * Define UART_POLLING to go back to polling the UART from a periodic reaction
+ * reposted on every tick, rather than being driven by its interrupts.
  */
-#define ECHO_ZZZ
+//#define UART_POLLING
+
+/*
+ * The number of stars animated by the `stars` command, see stars.h.
+ */
+#define STARS_DEMO 256
 
 extern uint32_t stack_top;
 
@@ -33,7 +41,59 @@ void check_memory() {
     panic();
 }
 
+static int streq(const char* a, const char* b) {
+  while (*a != '\0' && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+/*
+ * Console commands, a line that is not a command is echoed reversed.
+ */
 void line_handler(char* str) {
+  if (streq(str, "prof")) {
+    kprintf("\n");
+    prof_report();
+    return;
+  }
+  if (streq(str, "prof reset")) {
+    prof_reset();
+    return;
+  }
+  if (streq(str, "stats")) {
+    kprintf("\nuart0: %u bytes sent\n", uart_tx_bytes(UART0));
+    event_stats_dump();
+    return;
+  }
+  if (streq(str, "stats reset")) {
+    event_stats_reset();
+    return;
+  }
+  // start the stars, or stop them and report
+  if (streq(str, "stars")) {
+    kprintf("\n");
+    if (stars_running()) {
+      stars_stop();
+      stars_report();
+      stars_clear();
+    } else {
+      stars_scatter(STARS_DEMO, (uint32_t)time_now());
+      stars_start(TIMER_MS(50));
+    }
+    return;
+  }
+  if (streq(str, "perf")) {
+    perf_run();
+    return;
+  }
+  // a timestamp, in ticks, for host/qemu-bench.py
+  if (streq(str, "time")) {
+    kprintf(" time=%llu.", (unsigned long long)time_now());
+    return;
+  }
+
   int len = 0;
   while(str[len] != '\0') {
     len++;
@@ -45,6 +105,9 @@ void line_handler(char* str) {
   }
 }
 
+// Whether the cursor is drawn, in the framebuffer, at the console's cursor
+static int cursor_drawn;
+
 // Reaction for the cursor
 void animate_cursor_reaction(void* cookie) {
     static char cursor_chars[] = {'|', '/', '-', '\\'};
@@ -53,40 +116,53 @@ void animate_cursor_reaction(void* cookie) {
 
     int r, col;
     cursor_position(&r, &col);
+    if (r >= NROWS)
+      r = NROWS - 1; // where the terminal keeps its cursor
 
-    // draw new cursor
-    cursor_at(r, col);
-    console_color(cursor_color);
-    kprintf("%c", cursor_chars[cursor_idx]);
-    
-    // Restore cursor position and color for user typing
-    cursor_at(r, col);
-    console_color(COLOR_RESET);
+    // draw new cursor, the flush restores the cursor position
+    // and color for user typing
+    fb_put(r, col, cursor_chars[cursor_idx], FB_ATTR(cursor_color, COLOR_RESET));
+    fb_flush();
+    cursor_drawn = 1;
 
     // Update next frame
     cursor_idx = (cursor_idx + 1) % 4;
     cursor_color = (cursor_color == RED) ? WHITE : RED;
+}
+
+// Echo a byte typed on the keyboard
+void echo_input(uint8_t c) {
+    // Erase the old cursor before processing the character,
+    // and give its cell back to the console
+    if (cursor_drawn) {
+        int r, col;
+        cursor_position(&r, &col);
+        if (r >= NROWS)
+          r = NROWS - 1;
+        fb_put(r, col, ' ', FB_DEFAULT);
+        fb_flush();
+        fb_release(r, col);
+        cursor_drawn = 0;
+    }
 
-    // repost the event for the next frame
-    event_post(animate_cursor_reaction, NULL, 500000); // ~500ms??
+    console_echo(c);
 }
 
+#ifdef UART_POLLING
 // Reaction for polling UART
 void poll_uart_reaction(void* cookie) {
     uint8_t c;
-    if (uart_receive(UART0, &c) == 1) {
-        // Erase the old cursor before processing the character
-        int r, col;
-        cursor_position(&r, &col);
-        cursor_at(r, col);
-        kprintf(" ");
-        cursor_at(r, col);
-
-        console_echo(c);
-    }
-    // repost the event to continue polling
-    event_post(poll_uart_reaction, NULL, 1);
+    if (uart_receive(UART0, &c) == 1)
+        echo_input(c);
+}
+#else
+// Reaction for a batch of bytes received on UART0, posted by its interrupt handler
+void uart_rx_reaction(void* cookie) {
+    uint8_t c;
+    while (uart_receive(UART0, &c) == 1)
+        echo_input(c);
 }
+#endif
 
 
 /**
@@ -94,13 +170,22 @@ void poll_uart_reaction(void* cookie) {
  * in assembly language, see the startup.s file.
  */
 void _start() {
+  prof_init();
+  irqs_setup();
+  uart_tx_irq_enable(UART0, UART0_IRQ, UART_TX_BLOCK);
   console_init(line_handler);
+  fb_init();
   event_init();
   cursor_hide();
+  irqs_enable();
 
   // post initial events
-  event_post(poll_uart_reaction, NULL, 1);
-  event_post(animate_cursor_reaction, NULL, 1);
+#ifdef UART_POLLING
+  event_post_periodic_prio(poll_uart_reaction, NULL, 1, EVENT_PRIO_HIGH);
+#else
+  uart_rx_irq_enable(UART0, UART0_IRQ, uart_rx_reaction, NULL);
+#endif
+  event_post_periodic_prio(animate_cursor_reaction, NULL, TIMER_MS(500), EVENT_PRIO_LOW);
 
   // start the scheduler.
   event_loop();
@@ -39,56 +39,71 @@ void echo(uint32_t uartno, void *cookie);
 void panic();
 void kprintf(const char *fmt, ...);
 
+/*
+ * Formats like kprintf, but into the given buffer, without any I/O.
+ * At most size-1 characters are written, followed by a '\0'.
+ * Returns the length of the complete output, which is size or
+ * more if it was truncated.
+ */
+int ksnprintf(char *buf, size_t size, const char *fmt, ...);
+
+/*
+ * Divides n by d, by a binary long division, as kprintf does, there
+ * being no hardware divider. Returns the quotient, the remainder
+ * going to rem.
+ */
+uintmax_t divmodu(uintmax_t n, unsigned int d, unsigned int *rem);
+
 __inline__
 __attribute__((always_inline))
 uint32_t mmio_read8(void* bar, uint8_t offset) {
-  return *((uint8_t*)(bar+offset));
+  return *((volatile uint8_t*)(bar+offset));
 }
 
 __inline__
 __attribute__((always_inline))
 void mmio_write8(void* bar, uint32_t offset, uint8_t value) {
-  *((uint8_t*)(bar+offset)) = value;
+  *((volatile uint8_t*)(bar+offset)) = value;
 }
 
 __inline__
 __attribute__((always_inline))
 uint16_t mmio_read16(void* bar, uint32_t offset) {
-  return *((uint16_t*)(bar+offset));
+  return *((volatile uint16_t*)(bar+offset));
 }
 
 __inline__
 __attribute__((always_inline))
 void mmio_write16(void* bar, uint32_t offset, uint16_t value) {
-  *((uint16_t*)(bar+offset)) = value;
+  *((volatile uint16_t*)(bar+offset)) = value;
 }
 
 __inline__
 __attribute__((always_inline))
 uint32_t mmio_read32(void* bar, uint32_t offset) {
-  return *((uint32_t*)(bar+offset));
+  return *((volatile uint32_t*)(bar+offset));
 }
 
 __inline__
 __attribute__((always_inline))
 void mmio_write32(void* bar, uint32_t offset, uint32_t value) {
-  *((uint32_t*)(bar+offset)) = value;
+  *((volatile uint32_t*)(bar+offset)) = value;
 }
 
 __inline__
 __attribute__((always_inline))
 void mmio_set(void* bar, uint32_t offset, uint32_t bits) {
-  uint32_t value = *((uint32_t*)(bar+offset));
+  uint32_t value = *((volatile uint32_t*)(bar+offset));
   value |= bits;
-  *((uint32_t*)(bar+offset)) = value;
+  *((volatile uint32_t*)(bar+offset)) = value;
 }
 
 __inline__
 __attribute__((always_inline))
 void mmio_clear(void* bar, uint32_t offset, uint32_t bits) {
-  uint32_t value = *((uint32_t*)(bar+offset));
+  uint32_t value = *((volatile uint32_t*)(bar+offset));
   value &= ~bits;
-  *((uint32_t*)(bar+offset)) = value;
+  *((volatile uint32_t*)(bar+offset)) = value;
 }
 
 #endif /* MAIN_H_ */
@@ -0,0 +1,83 @@
+#include "main.h"
+#include "mmu.h"
+#include "isr.h"
+
+/**
+ * First-level descriptors of sections, mapping 1MB each,
+ * see the ARMv7-A Architecture Reference Manual, B3.5.1.
+ *    Bit Fields:
+ *      19:    NS    non-secure
+ *      17:    nG    not global
+ *      16:    S     shareable
+ *      15:    AP[2] read-only
+ *      14:12  TEX   type extension
+ *      11:10  AP    access permissions, 11 full access
+ *       8:5   Domain
+ *       4:    XN    execute never
+ *       3:    C     cacheable
+ *       2:    B     bufferable
+ *       1:0   type, 10 section, 00 fault
+ * With TEX, C and B at 001, 1 and 1, memory is normal, write-back
+ * and write-allocate, both inner and outer. At 000, 0 and 0, it is
+ * strongly ordered.
+ */
+#define SECTION           (2 << 0)
+#define SECTION_B         (1 << 2)
+#define SECTION_C         (1 << 3)
+#define SECTION_XN        (1 << 4)
+#define SECTION_AP_RW     (3 << 10)
+#define SECTION_TEX(tex)  ((tex) << 12)
+
+#define SECTION_NORMAL_WB \
+  (SECTION | SECTION_AP_RW | SECTION_TEX(1) | SECTION_C | SECTION_B)
+#define SECTION_STRONGLY_ORDERED \
+  (SECTION | SECTION_AP_RW | SECTION_XN)
+
+#define SECTION_SHIFT 20
+#define SECTIONS 4096
+#define DEVICE_SECTION (0x10100000 >> SECTION_SHIFT)
+
+/*
+ * The translation table must be aligned on its size, 16KB, it is
+ * placed in its own section, see versatile.ld, and filled at boot.
+ * The enabling and disabling themselves are in cache.S.
+ */
+static uint32_t mmu_table[SECTIONS] __attribute__((section(".mmu"), aligned(16384)));
+static int mmu_on;
+
+extern void _mmu_enable(uint32_t* table);
+extern void _mmu_disable(void);
+
+void mmu_init(void) {
+  uint32_t ram_sections = (MEMORY + (1 << SECTION_SHIFT) - 1) >> SECTION_SHIFT;
+  for (uint32_t i = 0; i < SECTIONS; i++) {
+    uint32_t base = i << SECTION_SHIFT;
+    if (i < ram_sections)
+      mmu_table[i] = base | SECTION_NORMAL_WB;
+    else if (i == DEVICE_SECTION)
+      mmu_table[i] = base | SECTION_STRONGLY_ORDERED;
+    else
+      mmu_table[i] = 0;
+  }
+  mmu_enable();
+}
+
+void mmu_enable(void) {
+  uint32_t flags = irqs_save();
+  if (!mmu_on)
+    _mmu_enable(mmu_table);
+  mmu_on = 1;
+  irqs_restore(flags);
+}
+
+void mmu_disable(void) {
+  uint32_t flags = irqs_save();
+  if (mmu_on)
+    _mmu_disable();
+  mmu_on = 0;
+  irqs_restore(flags);
+}
+
+int mmu_enabled(void) {
+  return mmu_on;
+}
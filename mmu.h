@@ -0,0 +1,37 @@
+#ifndef _MMU_H_
+#define _MMU_H_
+
+#include <stdint.h>
+
+/*
+ * The MMU of the Cortex-A8, with a flat identity map of 1MB sections,
+ * so that memory attributes can be set: the RAM is normal memory,
+ * cacheable write-back, and the device region of the Versatile board
+ * (0x101xxxxx, the VIC, the timers, the UARTs...) is strongly ordered
+ * and never executed. Any other address faults.
+ * See the ARM Architecture Reference Manual ARMv7-A, section B3.5.
+ *
+ * With the MMU on, the instruction and data caches and the branch
+ * predictor are enabled too, without the MMU, the data cache could
+ * not be turned on, as every access would be strongly ordered.
+ */
+
+/*
+ * Build the translation table and enable the MMU, the caches and
+ * the branch predictor, called once at boot, from startup.s.
+ */
+void mmu_init(void);
+
+/*
+ * Turn the MMU, the caches and the branch predictor off and back
+ * on, with the cache maintenance this requires, to compare both.
+ */
+void mmu_disable(void);
+void mmu_enable(void);
+
+/*
+ * Returns 1 if the MMU and the caches are on, 0 otherwise.
+ */
+int mmu_enabled(void);
+
+#endif /* _MMU_H_ */
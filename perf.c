@@ -0,0 +1,83 @@
+#include "main.h"
+#include "perf.h"
+#include "event.h"
+#include "mmu.h"
+
+/*
+ * Each benchmark runs 1000 operations, so that the total time in
+ * microseconds, the ticks of time_now(), is also the time of one
+ * operation in nanoseconds, without a division, which the hardware
+ * does not have and libgcc only does by a loop.
+ */
+#define PERF_OPS 1000
+
+struct perf_round {
+  uint32_t dispatch;   // ticks for PERF_OPS dispatches
+  uint32_t format;     // ticks for PERF_OPS ksnprintf
+  uint32_t bytes;      // bytes formatted
+};
+
+static struct perf_round rounds[2];
+static int round;
+static int running;
+static uint32_t chained;
+static uint64_t start;
+
+static void perf_format(struct perf_round* r) {
+  char buf[64];
+  uint32_t bytes = 0;
+  uint64_t begin = time_now();
+  for (uint32_t i = 0; i < PERF_OPS; i++) {
+    bytes += ksnprintf(buf, sizeof(buf), "%c[%d;%dH%s %u %x",
+        27, i & 31, i & 63, "event", i, i * 2654435761u);
+  }
+  r->format = (uint32_t)(time_now() - begin);
+  r->bytes = bytes;
+}
+
+static void perf_report(void) {
+  kprintf("\n%-10s %14s %14s\n", "", "mmu+caches on", "off");
+  kprintf("%-10s %11u ns %11u ns\n", "dispatch", rounds[0].dispatch, rounds[1].dispatch);
+  kprintf("%-10s %11u ns %11u ns\n", "ksnprintf", rounds[0].format, rounds[1].format);
+  kprintf("%-10s %14u\n", "bytes", rounds[0].bytes);
+}
+
+static void perf_chain(void* cookie);
+
+static void perf_round_start(void) {
+  chained = 0;
+  start = time_now();
+  event_post_prio(perf_chain, NULL, 0, EVENT_PRIO_HIGH);
+}
+
+/*
+ * The reaction of the dispatch benchmark, it posts itself until
+ * PERF_OPS dispatches are done, then runs the kprintf benchmark,
+ * and goes on to the next round.
+ */
+static void perf_chain(void* cookie) {
+  if (++chained < PERF_OPS) {
+    event_post_prio(perf_chain, NULL, 0, EVENT_PRIO_HIGH);
+    return;
+  }
+  rounds[round].dispatch = (uint32_t)(time_now() - start);
+  perf_format(&rounds[round]);
+  if (round == 0) {
+    round = 1;
+    mmu_disable();
+    perf_round_start();
+  } else {
+    mmu_enable();
+    running = 0;
+    perf_report();
+  }
+}
+
+void perf_run(void) {
+  if (running)
+    return;
+  running = 1;
+  round = 0;
+  mmu_enable();
+  perf_round_start();
+}
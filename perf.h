@@ -0,0 +1,13 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+/*
+ * Benchmarks of the event dispatch and of kprintf, run twice, with
+ * the MMU and the caches on, then off (see mmu.h), the results being
+ * printed on UART0 once both rounds are done. The dispatch round is
+ * a chain of reactions, each posting the next, run by the event loop
+ * like any other, so this returns right away.
+ */
+void perf_run(void);
+
+#endif /* _PERF_H_ */
@@ -0,0 +1,71 @@
+#include "main.h" // For NULL
+#include "pool.h"
+#include "atomic.h"
+
+void pool_init(struct pool* pool, uint32_t block_size) {
+  if (block_size < sizeof(void*))
+    block_size = sizeof(void*);
+  pool->block_size = (block_size + 7) & ~7u;
+  pool->free = NULL;
+  pool->blocks = 0;
+  pool->used = 0;
+  pool->high_water = 0;
+}
+
+static void pool_push(struct pool* pool, void* block) {
+  do {
+    *(void**)block = ldrex_ptr(&pool->free);
+  } while (strex_ptr(&pool->free, block));
+}
+
+/*
+ * Blocks are pushed last to first, so that they are allocated
+ * in the order of their addresses.
+ */
+uint32_t pool_grow(struct pool* pool, void* mem, uint32_t bytes) {
+  uint32_t size = pool->block_size;
+  uint32_t count = 0;
+  uint32_t offset = 0;
+  while (offset + size <= bytes) {
+    offset += size;
+    count++;
+  }
+  while (offset > 0) {
+    offset -= size;
+    pool_push(pool, (uint8_t*)mem + offset);
+  }
+  pool->blocks += count;
+  return count;
+}
+
+// count blocks in and out, and keep the high-water mark
+static void pool_count(struct pool* pool, int32_t delta) {
+  uint32_t used;
+  do {
+    used = ldrex_u32(&pool->used) + delta;
+  } while (strex_u32(&pool->used, used));
+  if (delta < 0)
+    return;
+  uint32_t high;
+  do {
+    high = ldrex_u32(&pool->high_water);
+    if (used <= high)
+      return;
+  } while (strex_u32(&pool->high_water, used));
+}
+
+void* pool_alloc(struct pool* pool) {
+  void* block;
+  do {
+    block = ldrex_ptr(&pool->free);
+    if (block == NULL)
+      return NULL;
+  } while (strex_ptr(&pool->free, *(void**)block));
+  pool_count(pool, 1);
+  return block;
+}
+
+void pool_free(struct pool* pool, void* block) {
+  pool_push(pool, block);
+  pool_count(pool, -1);
+}
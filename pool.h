@@ -0,0 +1,58 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdint.h>
+
+/*
+ * A pool of fixed-size blocks, allocated and freed in O(1) from
+ * a free list, without masking interrupts: the free list is only
+ * changed with exclusive accesses (see atomic.h), so interrupt
+ * handlers may allocate too. The link of a free block is kept in
+ * its first word, the rest of a block is left untouched while free.
+ *
+ * A pool starts empty, memory is given to it with pool_grow(), at
+ * start-up or later on. The memory of the static pools is placed
+ * in the .pool section (see versatile.ld), so that their footprint
+ * shows up on its own in the memory map:
+ *
+ *    static struct thing things[16] POOL_SECTION;
+ *    pool_init(&pool, sizeof(struct thing));
+ *    pool_grow(&pool, things, sizeof(things));
+ *
+ * The pool counts the blocks in use and remembers the highest count
+ * ever reached, the high-water mark, to size it from real data.
+ */
+struct pool {
+  void* volatile free;
+  uint32_t block_size;
+  uint32_t blocks;
+  volatile uint32_t used;
+  volatile uint32_t high_water;
+};
+
+#define POOL_SECTION __attribute__((section(".pool"), aligned(8)))
+
+/*
+ * Initialize an empty pool of blocks of the given size, at least
+ * a pointer, rounded up to keep the blocks aligned on 8 bytes.
+ */
+void pool_init(struct pool* pool, uint32_t block_size);
+
+/*
+ * Add the given memory to the pool, cut in as many blocks as fit.
+ * Returns the number of blocks added.
+ * Only from the thread of the event loop.
+ */
+uint32_t pool_grow(struct pool* pool, void* mem, uint32_t bytes);
+
+/*
+ * Returns a free block, or NULL if there is none left.
+ */
+void* pool_alloc(struct pool* pool);
+
+/*
+ * Give a block back to its pool.
+ */
+void pool_free(struct pool* pool, void* block);
+
+#endif /* _POOL_H_ */
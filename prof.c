@@ -0,0 +1,73 @@
+#include "main.h"
+#include "prof.h"
+
+/*
+ * CP15 c9, performance monitor registers:
+ *   PMCR (c9, c12, 0): control
+ *      Bit Fields:
+ *        3:  D  count every 64 cycles
+ *        2:  C  reset the cycle counter
+ *        0:  E  enable all counters
+ *   PMCNTENSET (c9, c12, 1): counter enable set
+ *      Bit 31 enables the cycle counter
+ *   PMOVSR (c9, c12, 3): overflow flag status
+ *      Bit 31 is the cycle counter overflow, write 1 to clear
+ */
+#define PMCR_E (1<<0)
+#define PMCR_C (1<<2)
+#define PMCR_D (1<<3)
+#define PMU_CYCLES (1<<31)
+
+// the scopes that ran at least once
+static struct prof_scope* scopes;
+
+void prof_init(void) {
+#ifdef PROF
+  uint32_t pmcr;
+  __asm__ volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+  pmcr = (pmcr | PMCR_E | PMCR_C) & ~PMCR_D;
+  __asm__ volatile("mcr p15, 0, %0, c9, c12, 0" :: "r"(pmcr));
+  __asm__ volatile("mcr p15, 0, %0, c9, c12, 3" :: "r"(PMU_CYCLES));
+  __asm__ volatile("mcr p15, 0, %0, c9, c12, 1" :: "r"(PMU_CYCLES));
+#endif
+}
+
+#ifdef PROF
+/*
+ * See "prof.h"
+ */
+void prof_end(struct prof_scope* scope) {
+  uint32_t cycles = prof_cycles() - scope->start;
+  if (!scope->listed) {
+    scope->listed = 1;
+    scope->next = scopes;
+    scopes = scope;
+  }
+  scope->count++;
+  scope->total += cycles;
+  if (cycles < scope->min)
+    scope->min = cycles;
+  if (cycles > scope->max)
+    scope->max = cycles;
+}
+#endif
+
+void prof_report(void) {
+  unsigned int rem;
+  kprintf("%-16s %10s %10s %10s %10s\n", "scope", "count", "min", "avg", "max");
+  for (struct prof_scope* s = scopes; s != NULL; s = s->next) {
+    if (s->count == 0)
+      continue;
+    kprintf("%-16s %10u %10u %10llu %10u\n", s->name, s->count, s->min,
+        divmodu(s->total, s->count, &rem), s->max);
+  }
+}
+
+void prof_reset(void) {
+  for (struct prof_scope* s = scopes; s != NULL; s = s->next) {
+    s->count = 0;
+    s->total = 0;
+    s->min = UINT32_MAX;
+    s->max = 0;
+  }
+}
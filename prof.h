@@ -0,0 +1,84 @@
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include <stdint.h>
+
+/*
+ * Profiling with the cycle counter (PMCCNTR) of the performance
+ * monitor of the Cortex-A8, see the Cortex-A8 Technical Reference
+ * Manual, section 3.2.42 and onward (c9 registers of CP15).
+ *
+ * A scope is a named piece of code, timed between prof_begin and
+ * prof_end, that accumulates the number of runs and the min, max
+ * and total number of cycles. A scope is not reentrant, but scopes
+ * may be nested. For example:
+ *
+ *    PROF_SCOPE(draw_scope, "draw");
+ *    ...
+ *    prof_begin(&draw_scope);
+ *    draw();
+ *    prof_end(&draw_scope);
+ *
+ * Profiling is compiled in only if PROF is defined, see the
+ * Makefile, otherwise prof_begin and prof_end do nothing.
+ */
+struct prof_scope {
+  const char* name;
+  uint32_t start;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  int listed;
+  struct prof_scope* next;
+};
+
+#define PROF_SCOPE(var, name) \
+  static struct prof_scope var = { name, 0, 0, UINT32_MAX, 0, 0, 0, NULL }
+
+/*
+ * Enable and reset the cycle counter.
+ */
+void prof_init(void);
+
+/*
+ * Print, on UART0, the statistics of all the scopes run so far.
+ */
+void prof_report(void);
+
+/*
+ * Reset the statistics of all the scopes.
+ */
+void prof_reset(void);
+
+#ifdef PROF
+
+/*
+ * Read the cycle counter, it wraps around every 2^32 cycles,
+ * so scopes must be shorter than that.
+ */
+__inline__
+__attribute__((always_inline))
+uint32_t prof_cycles(void) {
+  uint32_t cycles;
+  __asm__ volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles));
+  return cycles;
+}
+
+__inline__
+__attribute__((always_inline))
+void prof_begin(struct prof_scope* scope) {
+  scope->start = prof_cycles();
+}
+
+void prof_end(struct prof_scope* scope);
+
+#else
+
+#define prof_cycles() 0
+#define prof_begin(scope) do { (void)(scope); } while (0)
+#define prof_end(scope) do { (void)(scope); } while (0)
+
+#endif /* PROF */
+
+#endif /* _PROF_H_ */
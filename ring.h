@@ -0,0 +1,99 @@
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdint.h>
+
+/*
+ * A lock-free byte ring, for exactly one producer and one consumer,
+ * typically an interrupt handler on one side and a reaction on the
+ * other side. The producer only writes the head, the consumer only
+ * writes the tail, and both indexes grow freely, wrapping around
+ * at 2^32, so that head - tail is always the number of bytes in
+ * the ring. The size must be a power of two.
+ *
+ * We run on a single core, so a compiler barrier is enough to
+ * order the accesses to the data and to the indexes.
+ */
+struct ring {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  uint32_t mask;
+  uint8_t* data;
+};
+
+#define ring_barrier() __asm__ volatile("" ::: "memory")
+
+static inline void ring_init(struct ring* r, uint8_t* data, uint32_t size) {
+  r->head = 0;
+  r->tail = 0;
+  r->mask = size - 1;
+  r->data = data;
+}
+
+static inline uint32_t ring_count(struct ring* r) {
+  return r->head - r->tail;
+}
+
+static inline uint32_t ring_room(struct ring* r) {
+  return r->mask + 1 - (r->head - r->tail);
+}
+
+/*
+ * Producer side, returns 0 if the ring is full.
+ */
+static inline int ring_put(struct ring* r, uint8_t b) {
+  uint32_t head = r->head;
+  if (head - r->tail > r->mask)
+    return 0;
+  r->data[head & r->mask] = b;
+  ring_barrier();
+  r->head = head + 1;
+  return 1;
+}
+
+/*
+ * Consumer side, returns 0 if the ring is empty.
+ */
+static inline int ring_get(struct ring* r, uint8_t* b) {
+  uint32_t tail = r->tail;
+  if (r->head == tail)
+    return 0;
+  *b = r->data[tail & r->mask];
+  ring_barrier();
+  r->tail = tail + 1;
+  return 1;
+}
+
+/*
+ * Producer side, in bulk, publishing all the bytes at once.
+ * Returns the number of bytes put, as many as there is room for.
+ */
+static inline uint32_t ring_write(struct ring* r, const uint8_t* buf, uint32_t len) {
+  uint32_t head = r->head;
+  uint32_t room = r->mask + 1 - (head - r->tail);
+  if (len > room)
+    len = room;
+  for (uint32_t i = 0; i < len; i++)
+    r->data[(head + i) & r->mask] = buf[i];
+  ring_barrier();
+  r->head = head + len;
+  return len;
+}
+
+/*
+ * Consumer side, in bulk, releasing all the bytes at once.
+ * Returns the number of bytes got, as many as there are.
+ */
+static inline uint32_t ring_read(struct ring* r, uint8_t* buf, uint32_t len) {
+  uint32_t tail = r->tail;
+  uint32_t count = r->head - tail;
+  if (len > count)
+    len = count;
+  for (uint32_t i = 0; i < len; i++)
+    buf[i] = r->data[(tail + i) & r->mask];
+  ring_barrier();
+  r->tail = tail + len;
+  return len;
+}
+
+#endif /* _RING_H_ */
@@ -0,0 +1,173 @@
+#include "stars.h"
+#include "fb.h"
+#include "event.h"
+#include "timer.h"
+
+/*
+ * The stars, a field per array, wait being the number of frames
+ * before the next move, the glyphs being read only when drawing.
+ */
+static struct {
+  uint32_t count;
+  int16_t line[STARS_MAX];
+  int16_t col[STARS_MAX];
+  uint8_t delay[STARS_MAX];
+  uint8_t wait[STARS_MAX];
+  uint8_t index[STARS_MAX];
+  uint8_t display[STARS_MAX];
+  char glyph[STARS_MAX][8];
+} stars;
+
+// a bit per star that moves in the current frame
+static uint32_t moved[(STARS_MAX + 31) / 32];
+
+static event_handle_t animation = EVENT_NONE;
+
+// since started: frames, bytes sent, and ticks spent rendering
+static uint32_t frames;
+static uint32_t frame_bytes;
+static uint32_t frame_ticks;
+static uint64_t started;
+
+static uint8_t glyph_next(const char* glyph, uint8_t index) {
+  index++;
+  if (index == 8 || glyph[index] == 0)
+    index = 0;
+  return index;
+}
+
+/*
+ * Moving a single star, one step, as a frame does for each star whose
+ * delay is over, for a star that is not animated by the engine.
+ * The framebuffer must then be flushed.
+ */
+void moveStar(struct star* s) {
+  char glyph[8];
+  for (int k = 0; k < 8; k++)
+    glyph[k] = (char)s->charac[k];
+  if (s->display)
+    fb_put(s->line, s->col, ' ', FB_DEFAULT);
+  s->col = (s->col + 1 < NCOLS) ? s->col + 1 : 0;
+  s->index = glyph_next(glyph, s->index & 7);
+  if (s->display)
+    fb_put(s->line, s->col, glyph[s->index], FB_DEFAULT);
+}
+
+int stars_add(const struct star* s) {
+  if (stars.count == STARS_MAX)
+    return -1;
+  uint32_t i = stars.count++;
+  stars.line[i] = (s->line < 0) ? 0 : (s->line < NROWS) ? s->line : NROWS - 1;
+  stars.col[i] = (s->col < 0) ? 0 : (s->col < NCOLS) ? s->col : NCOLS - 1;
+  stars.delay[i] = (s->delay < 1) ? 1 : (s->delay > 255) ? 255 : s->delay;
+  stars.wait[i] = stars.delay[i];
+  stars.index[i] = s->index & 7;
+  stars.display[i] = s->display;
+  for (int k = 0; k < 8; k++)
+    stars.glyph[i][k] = (char)s->charac[k];
+  if (stars.glyph[i][stars.index[i]] == 0)
+    stars.index[i] = 0;
+  return i;
+}
+
+uint32_t stars_scatter(uint32_t count, uint32_t seed) {
+  struct star s = {
+    .index = 0,
+    .charac = { '.', '+', '*', '+', 0 },
+    .display = TRUE,
+  };
+  uint32_t added;
+  for (added = 0; added < count; added++) {
+    // a linear congruential generator, see Numerical Recipes
+    seed = seed * 1664525 + 1013904223;
+    // scaled to the screen by a multiplication rather than a modulo
+    s.line = (((seed >> 8) & 0xff) * NROWS) >> 8;
+    s.col = (((seed >> 16) & 0xfff) * NCOLS) >> 12;
+    s.delay = 1 + (seed >> 29);
+    s.index = (seed >> 4) & 3;
+    if (stars_add(&s) < 0)
+      break;
+  }
+  return added;
+}
+
+void stars_clear(void) {
+  for (uint32_t i = 0; i < stars.count; i++)
+    if (stars.display[i])
+      fb_put(stars.line[i], stars.col[i], ' ', FB_DEFAULT);
+  fb_flush();
+  // give the cells back to the console
+  for (uint32_t i = 0; i < stars.count; i++)
+    fb_release(stars.line[i], stars.col[i]);
+  stars.count = 0;
+}
+
+uint32_t stars_frame(void) {
+  uint32_t count = stars.count;
+  uint64_t start = time_now();
+
+  // the stars whose delay is over are erased, then move, all of
+  // them, before any is drawn, a star may share a cell with another
+  for (uint32_t w = 0; w < (count + 31) >> 5; w++)
+    moved[w] = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (--stars.wait[i] != 0)
+      continue;
+    stars.wait[i] = stars.delay[i];
+    moved[i >> 5] |= 1u << (i & 31);
+    if (stars.display[i])
+      fb_put(stars.line[i], stars.col[i], ' ', FB_DEFAULT);
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if ((moved[i >> 5] & (1u << (i & 31))) == 0)
+      continue;
+    stars.col[i] = (stars.col[i] + 1 < NCOLS) ? stars.col[i] + 1 : 0;
+    stars.index[i] = glyph_next(stars.glyph[i], stars.index[i]);
+  }
+
+  // draw them all, the framebuffer sends only what changed
+  for (uint32_t i = 0; i < count; i++)
+    if (stars.display[i])
+      fb_put(stars.line[i], stars.col[i], stars.glyph[i][stars.index[i]], FB_DEFAULT);
+  uint32_t bytes = fb_flush();
+
+  frames++;
+  frame_bytes += bytes;
+  frame_ticks += (uint32_t)(time_now() - start);
+  return bytes;
+}
+
+static void stars_reaction(void* cookie) {
+  stars_frame();
+}
+
+void stars_start(uint32_t period) {
+  if (animation != EVENT_NONE)
+    return;
+  frames = 0;
+  frame_bytes = 0;
+  frame_ticks = 0;
+  started = time_now();
+  animation = event_post_periodic_prio(stars_reaction, NULL, period, EVENT_PRIO_LOW);
+}
+
+void stars_stop(void) {
+  if (animation == EVENT_NONE)
+    return;
+  event_cancel(animation);
+  animation = EVENT_NONE;
+}
+
+int stars_running(void) {
+  return animation != EVENT_NONE;
+}
+
+void stars_report(void) {
+  unsigned int rem;
+  uint32_t elapsed_ms = divmodu(time_now() - started, TIMER_MS(1), &rem);
+  uint32_t n = frames ? frames : 1;
+  uint32_t rate = elapsed_ms ? divmodu((uint64_t)frames * 1000, elapsed_ms, &rem) : 0;
+  kprintf("stars: %u sprites, %u frames, %u frames/s, %u bytes/frame, %u us/frame\n",
+      stars.count, frames, rate, (uint32_t)divmodu(frame_bytes, n, &rem),
+      (uint32_t)divmodu(frame_ticks, n, &rem));
+}
@@ -0,0 +1,61 @@
+#ifndef _STARS_H_
+#define _STARS_H_
+
+#include <stdint.h>
+#include "main.h"
+
+/*
+ * A sprite engine for the stars of main.h, drawn in the framebuffer
+ * (see fb.h). A star moves one column to the right every delay frames,
+ * wrapping around at the end of its line, its glyph cycling through
+ * charac[], from index, up to the first 0 or the eighth one. Only the
+ * stars that display are drawn.
+ *
+ * The stars are kept as arrays of each of their fields rather than
+ * as an array of structures, so that a frame goes through the fields
+ * it needs, contiguous, a pass for the stars that move, then a pass
+ * drawing them all in the framebuffer, flushed once, as one frame.
+ * All the stars are animated by a single periodic event.
+ */
+#ifndef STARS_MAX
+#define STARS_MAX 512
+#endif
+
+/*
+ * Add a star, copied, with a delay of at least one frame.
+ * Returns its number, or -1 if there are STARS_MAX stars already.
+ */
+int stars_add(const struct star* s);
+
+/*
+ * Add count stars, scattered over the screen, with various delays,
+ * the seed choosing where. Returns the number of stars added.
+ */
+uint32_t stars_scatter(uint32_t count, uint32_t seed);
+
+/*
+ * Remove all the stars, erasing them from the screen.
+ */
+void stars_clear(void);
+
+/*
+ * Animate the stars, a frame every period ticks, until stopped.
+ * Starting resets the statistics.
+ */
+void stars_start(uint32_t period);
+void stars_stop(void);
+int stars_running(void);
+
+/*
+ * Move the stars whose delay is over and render the frame, as
+ * the periodic event does. Returns the number of bytes sent.
+ */
+uint32_t stars_frame(void);
+
+/*
+ * Print, on UART0, the number of stars and of frames since started,
+ * and the frames per second, bytes per frame and time per frame.
+ */
+void stars_report(void);
+
+#endif /* _STARS_H_ */
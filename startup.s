@@ -35,6 +35,13 @@ _reset_handler:
 	cmp	r4, r9
 	blo	1b
   
+	/*
+	 * Identity-map the memory and turn the MMU, the caches and the
+	 * branch predictor on, see mmu.h, the bss must be cleared first
+	 * since the translation table is built in C.
+	 */
+	bl	mmu_init
+
  	/*
  	 * Now upcall the C entry function  _start(void)
  	 */
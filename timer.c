@@ -0,0 +1,114 @@
+#include "main.h"
+#include "timer.h"
+#include "isr.h"
+
+/**
+ * SP804 Dual-Timer
+ *     http://infocenter.arm.com/help/topic/com.arm.doc.ddi0271d/DDI0271.pdf
+ *
+ * The registers of the second timer of a module are at offset 0x20.
+ *
+ * TimerXLoad:    Load Register     (0x00)
+ *    The value to count down from.
+ * TimerXValue:   Current Value     (0x04)
+ * TimerXControl: Control Register  (0x08)
+ *    Bit Fields:
+ *      7:   TimerEn     enable
+ *      6:   TimerMode   0 free-running, 1 periodic
+ *      5:   IntEnable   interrupt enable
+ *      3:2  TimerPre    prescale, 00 is divide by 1
+ *      1:   TimerSize   0 16-bit, 1 32-bit counter
+ *      0:   OneShot     0 wrapping, 1 one-shot
+ * TimerXIntClr:  Interrupt Clear   (0x0C)
+ *    Any write clears the interrupt.
+ */
+#define TIMER_LOAD    0x00
+#define TIMER_VALUE   0x04
+#define TIMER_CONTROL 0x08
+#define TIMER_INTCLR  0x0C
+
+#define TIMER_EN       (1<<7)
+#define TIMER_PERIODIC (1<<6)
+#define TIMER_INTEN    (1<<5)
+#define TIMER_32BIT    (1<<1)
+#define TIMER_ONESHOT  (1<<0)
+
+#define TIMER0 TIMER01
+#define TIMER1 (TIMER01 + 0x20)
+
+/*
+ * The system controller (SP810) selects the reference clock of
+ * each timer, either the 32kHz REFCLK or the 1MHz TIMCLK, through
+ * the TimerEnXSel bits of its control register (SCCTRL).
+ */
+#define SYSCTRL (void*)0x101e0000
+#define SCCTRL 0x00
+#define SCCTRL_TIMER0_TIMCLK (1<<15)
+#define SCCTRL_TIMER1_TIMCLK (1<<17)
+
+static uint32_t last_elapsed;
+static uint64_t wraps;
+
+/*
+ * The wake-up timer only has to wake up the processor,
+ * its interrupt just needs to be cleared.
+ */
+static void timer_isr(uint32_t irq, void* cookie) {
+  mmio_write32(TIMER1, TIMER_INTCLR, 1);
+}
+
+void timer_init(void) {
+  mmio_set(SYSCTRL, SCCTRL, SCCTRL_TIMER0_TIMCLK | SCCTRL_TIMER1_TIMCLK);
+
+  // free-running, 32-bit, no interrupt, counting down from 0xFFFFFFFF
+  mmio_write32(TIMER0, TIMER_CONTROL, 0);
+  mmio_write32(TIMER0, TIMER_LOAD, 0xFFFFFFFF);
+  mmio_write32(TIMER0, TIMER_CONTROL, TIMER_EN | TIMER_32BIT);
+
+  last_elapsed = 0;
+  wraps = 0;
+
+  // timer 1 is the wake-up timer, leave it stopped until needed
+  timer_wakeup_cancel();
+  irq_enable(TIMER1_IRQ, timer_isr, NULL);
+}
+
+/*
+ * See "timer.h"
+ */
+uint64_t timer_now(void) {
+  // interrupt handlers may read the time too
+  uint32_t flags = irqs_save();
+  // the counter counts down, the elapsed ticks are its complement
+  uint32_t elapsed = ~mmio_read32(TIMER0, TIMER_VALUE);
+  if (elapsed < last_elapsed)
+    wraps += 1ull << 32;
+  last_elapsed = elapsed;
+  uint64_t now = wraps | elapsed;
+  irqs_restore(flags);
+  return now;
+}
+
+/*
+ * See "timer.h"
+ */
+void timer_wakeup_at(uint64_t deadline) {
+  uint64_t now = timer_now();
+  uint32_t delay = 1;
+  if (deadline > now) {
+    uint64_t delta = deadline - now;
+    delay = (delta > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)delta;
+  }
+  mmio_write32(TIMER1, TIMER_CONTROL, 0);
+  mmio_write32(TIMER1, TIMER_INTCLR, 1);
+  mmio_write32(TIMER1, TIMER_LOAD, delay);
+  mmio_write32(TIMER1, TIMER_CONTROL, TIMER_EN | TIMER_ONESHOT | TIMER_INTEN | TIMER_32BIT);
+}
+
+/*
+ * See "timer.h"
+ */
+void timer_wakeup_cancel(void) {
+  mmio_write32(TIMER1, TIMER_CONTROL, 0);
+  mmio_write32(TIMER1, TIMER_INTCLR, 1);
+}
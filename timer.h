@@ -0,0 +1,57 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <stdint.h>
+
+/**
+ * Dual-Timer modules (SP804) of the Versatile Application Board,
+ * see the memory map in DUI0225, section 4.1, and the
+ * ARM Dual-Timer Module (SP804) Technical Reference Manual:
+ *
+ *    http://infocenter.arm.com/help/topic/com.arm.doc.ddi0271d/DDI0271.pdf
+ *
+ * Each module holds two timers, timers 0 and 1 share an interrupt
+ * line, so do timers 2 and 3 (see isr.h).
+ */
+#define TIMER01 (void*)0x101e2000
+#define TIMER23 (void*)0x101e3000
+
+/*
+ * The timers are clocked by TIMCLK, at 1MHz, so one tick
+ * of the time base is one microsecond.
+ */
+#define TIMER_HZ 1000000
+#define TIMER_MS(ms) ((ms) * (TIMER_HZ / 1000))
+
+/*
+ * Setup timer 0 as a free-running counter, the time base of time_now(),
+ * and timer 1 as the wake-up timer. The interrupts must have been
+ * setup already, see irqs_setup() in isr.h.
+ */
+void timer_init(void);
+
+/*
+ * Returns the number of ticks since timer_init(), as a monotonic
+ * 64-bit clock. The hardware counter is only 32-bit wide, its
+ * wrap-arounds are accounted for as long as this function is
+ * called at least once per wrap-around, that is, every 71 minutes.
+ */
+uint64_t timer_now(void);
+
+/*
+ * Arm timer 1 as a one-shot timer, firing at the given time,
+ * or right away if that time is already past. Its interrupt is
+ * enabled at the VIC, so it wakes up the processor from a wfi,
+ * even when interrupts are disabled at the processor, its
+ * handler only clears it.
+ * Times too far ahead are clamped, the timer then fires early,
+ * after 2^32 ticks.
+ */
+void timer_wakeup_at(uint64_t deadline);
+
+/*
+ * Stop timer 1 and clear its interrupt, if it fired.
+ */
+void timer_wakeup_cancel(void);
+
+#endif /* _TIMER_H_ */
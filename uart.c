@@ -1,5 +1,8 @@
 #include "main.h"
 #include "uart.h"
+#include "ring.h"
+#include "isr.h"
+#include "event.h"
 
 /**
  * PL011_T UART
@@ -19,10 +22,25 @@
  *      5:  TXFF  transmit FIFO full
  *      4:  RXFE  receive FIFO empty
  *      3:  BUSY  set when the UART is busy transmitting data
+ * UARTLCR_H: Line Control Register (0x2C)
+ *    Bit Fields:
+ *      4:  FEN   enable the 16-byte FIFOs
+ * UARTIMSC: Interrupt Mask Set/Clear Register (0x38)
+ * UARTMIS:  Masked Interrupt Status Register  (0x40)
+ * UARTICR:  Interrupt Clear Register          (0x44)
+ *    Bit Fields, for all three:
+ *      6:  RT    receive timeout, the RX FIFO is not empty
+ *                but has not been filled up to its trigger level
+ *      5:  TX    transmit, the TX FIFO is below its trigger level
+ *      4:  RX    receive, the RX FIFO is above its trigger level
  */
 
 #define UART_DR 0x00
 #define UART_FR 0x18
+#define UART_LCRH 0x2C
+#define UART_IMSC 0x38
+#define UART_MIS 0x40
+#define UART_ICR 0x44
 
 #define UART_TXFE (1<<7)
 #define UART_RXFF (1<<6)
@@ -30,37 +48,347 @@
 #define UART_RXFE (1<<4)
 #define UART_BUSY (1<<3)
 
+#define UART_FEN (1<<4)
+
+#define UART_RTI (1<<6)
+#define UART_TXI (1<<5)
+#define UART_RXI (1<<4)
+
+/*
+ * The PL011 FIFOs are 16-byte deep, when enabled,
+ * otherwise they are 1-byte holding registers.
+ */
+#define UART_FIFO_DEPTH 16
+
+/*
+ * The software state of each UART, when interrupt-driven.
+ * The receive ring is filled by the interrupt handler,
+ * and drained by the reactions, through uart_receive().
+ * The transmit ring is filled by the reactions, through
+ * uart_send(), and drained by the interrupt handler.
+ * While tx_active is set, the TX interrupt is enabled and
+ * the handler will pick up whatever is added to the ring.
+ */
+#define NUARTS 3
+#define UART_RX_RING_SIZE 256
+#define UART_TX_RING_SIZE 512
+
+struct uart {
+  void* bar;
+  int fifo_depth;
+  int rx_irq;
+  volatile int rx_posted;
+  void (*rx_react)(void*);
+  void* rx_cookie;
+  uint32_t rx_overruns;
+  struct ring rx_ring;
+  uint8_t rx_data[UART_RX_RING_SIZE];
+  int tx_irq;
+  int tx_policy;
+  volatile int tx_active;
+  uint32_t tx_dropped;
+  uint32_t tx_bytes;
+  struct ring tx_ring;
+  uint8_t tx_data[UART_TX_RING_SIZE];
+};
+static struct uart uarts[NUARTS];
+
+static struct uart* uart_state(void* uart) {
+  uint32_t index = ((uintptr_t)uart - (uintptr_t)UART0) >> 12;
+  struct uart* u = &uarts[index];
+  if (u->bar == NULL) {
+    u->bar = uart;
+    u->fifo_depth = (mmio_read32(uart, UART_LCRH) & UART_FEN) ? UART_FIFO_DEPTH : 1;
+  }
+  return u;
+}
+
+static void uart_fifo_enable(struct uart* u) {
+  mmio_set(u->bar, UART_LCRH, UART_FEN);
+  u->fifo_depth = UART_FIFO_DEPTH;
+}
+
+/*
+ * Bursts: the flag register is read once, telling how many
+ * bytes can be moved without looking at it again, the whole
+ * FIFO if the TX FIFO is empty, or if the RX FIFO is full,
+ * otherwise at least one byte if it is not full, or not empty.
+ */
+static uint32_t uart_tx_burst(struct uart* u) {
+  uint32_t fr = mmio_read32(u->bar, UART_FR);
+  if (fr & UART_TXFE)
+    return u->fifo_depth;
+  return (fr & UART_TXFF) ? 0 : 1;
+}
+
+static uint32_t uart_rx_burst(struct uart* u) {
+  uint32_t fr = mmio_read32(u->bar, UART_FR);
+  if (fr & UART_RXFF)
+    return u->fifo_depth;
+  return (fr & UART_RXFE) ? 0 : 1;
+}
+
 /*
  * See "uart.h"
  */
 int uart_receive(void* uart, uint8_t *b) {
-  uint16_t* uart_fr = (uint16_t*) (uart + UART_FR);
-  uint16_t* uart_dr = (uint16_t*) (uart + UART_DR);
+  struct uart* u = uart_state(uart);
+  if (u->rx_irq)
+    return ring_get(&u->rx_ring, b);
+  volatile uint16_t* uart_fr = (volatile uint16_t*) (uart + UART_FR);
+  volatile uint16_t* uart_dr = (volatile uint16_t*) (uart + UART_DR);
   if (*uart_fr & UART_RXFE)
     return 0;
   *b = (uint8_t)(*uart_dr & 0xff);
   return 1;
 }
 
+/*
+ * Move bytes from the transmit ring to the TX FIFO, until
+ * either is full or empty. This is the consumer side of the
+ * ring, so it runs either in the interrupt handler or with
+ * interrupts disabled.
+ */
+static void uart_tx_fill(struct uart* u) {
+  uint8_t burst[UART_FIFO_DEPTH];
+  uint32_t n;
+  while (ring_count(&u->tx_ring) > 0 && (n = uart_tx_burst(u)) > 0) {
+    n = ring_read(&u->tx_ring, burst, n);
+    for (uint32_t i = 0; i < n; i++)
+      mmio_write32(u->bar, UART_DR, burst[i]);
+  }
+}
+
+/*
+ * Start the transmission if the interrupt handler is not
+ * already at it, priming the TX FIFO, which raises the TX
+ * interrupt once drained, if more bytes are waiting.
+ */
+static void uart_tx_kick(struct uart* u) {
+  if (u->tx_active)
+    return;
+  uint32_t flags = irqs_save();
+  uart_tx_fill(u);
+  if (ring_count(&u->tx_ring) > 0) {
+    u->tx_active = 1;
+    mmio_set(u->bar, UART_IMSC, UART_TXI);
+  }
+  irqs_restore(flags);
+}
+
+/*
+ * Queue bytes, applying the back-pressure policy if the ring
+ * is full: either drop the bytes, or push bytes out ourselves,
+ * spinning on the UART, which also works with interrupts disabled.
+ * Returns the number of bytes queued, the others were dropped.
+ */
+static uint32_t uart_tx_put(struct uart* u, const uint8_t* buf, uint32_t len, int policy) {
+  uint32_t queued = 0;
+  for (;;) {
+    queued += ring_write(&u->tx_ring, buf + queued, len - queued);
+    uart_tx_kick(u);
+    if (queued == len || policy != UART_TX_BLOCK)
+      return queued;
+    uint32_t flags = irqs_save();
+    uart_tx_fill(u);
+    irqs_restore(flags);
+  }
+}
+
 /*
  * See "uart.h"
  */
 void uart_send(void* uart, uint8_t b) {
-  uint16_t* uart_fr = (uint16_t*) (uart + UART_FR);
-  uint16_t* uart_dr = (uint16_t*) (uart + UART_DR);
+  struct uart* u = uart_state(uart);
+  u->tx_bytes++;
+  if (u->tx_irq) {
+    if (uart_tx_put(u, &b, 1, u->tx_policy) == 0)
+      u->tx_dropped++;
+    return;
+  }
+  volatile uint16_t* uart_fr = (volatile uint16_t*) (uart + UART_FR);
+  volatile uint16_t* uart_dr = (volatile uint16_t*) (uart + UART_DR);
   while (*uart_fr & UART_TXFF)
     ;
   *uart_dr = (uint16_t)b;
 }
 
+/*
+ * See "uart.h"
+ */
+int uart_try_send(void* uart, uint8_t b) {
+  struct uart* u = uart_state(uart);
+  if (u->tx_irq) {
+    uint32_t sent = uart_tx_put(u, &b, 1, UART_TX_DROP);
+    u->tx_bytes += sent;
+    return sent;
+  }
+  if (mmio_read32(uart, UART_FR) & UART_TXFF)
+    return 0;
+  mmio_write32(uart, UART_DR, b);
+  u->tx_bytes++;
+  return 1;
+}
+
+/*
+ * See "uart.h"
+ */
+void uart_flush(void* uart) {
+  struct uart* u = uart_state(uart);
+  while (ring_count(&u->tx_ring) > 0) {
+    uint32_t flags = irqs_save();
+    uart_tx_fill(u);
+    irqs_restore(flags);
+  }
+  while (mmio_read32(uart, UART_FR) & UART_BUSY)
+    ;
+}
+
+/*
+ * See "uart.h"
+ */
+void uart_send_buffer(void* uart, const uint8_t* buf, uint32_t len) {
+  struct uart* u = uart_state(uart);
+  u->tx_bytes += len;
+  if (u->tx_irq) {
+    u->tx_dropped += len - uart_tx_put(u, buf, len, u->tx_policy);
+    return;
+  }
+  while (len > 0) {
+    uint32_t n = uart_tx_burst(u);
+    if (n > len)
+      n = len;
+    for (uint32_t i = 0; i < n; i++)
+      mmio_write32(uart, UART_DR, buf[i]);
+    buf += n;
+    len -= n;
+  }
+}
+
+/*
+ * See "uart.h"
+ */
+uint32_t uart_receive_buffer(void* uart, uint8_t* buf, uint32_t len) {
+  struct uart* u = uart_state(uart);
+  if (u->rx_irq)
+    return ring_read(&u->rx_ring, buf, len);
+  uint32_t count = 0;
+  uint32_t n;
+  while (count < len && (n = uart_rx_burst(u)) > 0) {
+    if (n > len - count)
+      n = len - count;
+    for (uint32_t i = 0; i < n; i++)
+      buf[count++] = (uint8_t)(mmio_read32(uart, UART_DR) & 0xff);
+  }
+  return count;
+}
+
 /*
  * See "uart.h"
  */
 void uart_send_string(void* uart, const unsigned char *s) {
+  // the following only works because characters in C
+  // are ASCII characters, encoded on 8 bits.
+  const unsigned char* chunk = s;
   while (*s != '\0') {
-    // the following line only works because characters in C
-    // are ASCII characters, encoded on 8 bits.
-    uart_send(uart, (uint8_t)*s);
     s++;
+    if (s - chunk == UART_FIFO_DEPTH) {
+      uart_send_buffer(uart, chunk, s - chunk);
+      chunk = s;
+    }
+  }
+  uart_send_buffer(uart, chunk, s - chunk);
+}
+
+/*
+ * The reaction posted by the interrupt handler, it acknowledges
+ * the batch before the user reaction drains the ring, so that
+ * bytes received meanwhile trigger another batch.
+ */
+static void uart_rx_react(void* cookie) {
+  struct uart* u = (struct uart*)cookie;
+  u->rx_posted = 0;
+  u->rx_react(u->rx_cookie);
+}
+
+static void uart_isr(uint32_t irq, void* cookie) {
+  struct uart* u = (struct uart*)cookie;
+  uint32_t mis = mmio_read32(u->bar, UART_MIS);
+  if (mis & (UART_RXI | UART_RTI)) {
+    // drain the RX FIFO, which also clears the RX interrupt
+    uint8_t burst[UART_FIFO_DEPTH];
+    uint32_t n;
+    while ((n = uart_rx_burst(u)) > 0) {
+      for (uint32_t i = 0; i < n; i++)
+        burst[i] = (uint8_t)(mmio_read32(u->bar, UART_DR) & 0xff);
+      u->rx_overruns += n - ring_write(&u->rx_ring, burst, n);
+    }
+    mmio_write32(u->bar, UART_ICR, UART_RXI | UART_RTI);
+    // if the post is lost, the bytes wait in the ring, the next
+    // interrupt posting again
+    if (!u->rx_posted && ring_count(&u->rx_ring) > 0)
+      u->rx_posted = event_post_from_isr(uart_rx_react, u, 0, EVENT_PRIO_HIGH);
   }
+  if (mis & UART_TXI) {
+    uart_tx_fill(u);
+    if (ring_count(&u->tx_ring) == 0) {
+      mmio_clear(u->bar, UART_IMSC, UART_TXI);
+      u->tx_active = 0;
+    }
+    mmio_write32(u->bar, UART_ICR, UART_TXI);
+  }
+}
+
+/*
+ * See "uart.h"
+ */
+void uart_rx_irq_enable(void* uart, uint32_t irq, void (*react)(void*), void* cookie) {
+  struct uart* u = uart_state(uart);
+  ring_init(&u->rx_ring, u->rx_data, UART_RX_RING_SIZE);
+  u->rx_react = react;
+  u->rx_cookie = cookie;
+  u->rx_posted = 0;
+  u->rx_overruns = 0;
+  u->rx_irq = 1;
+
+  // use the FIFOs, so that a burst is taken in one interrupt
+  uart_fifo_enable(u);
+  irq_enable(irq, uart_isr, u);
+  mmio_set(uart, UART_IMSC, UART_RXI | UART_RTI);
+}
+
+/*
+ * See "uart.h"
+ */
+uint32_t uart_rx_overruns(void* uart) {
+  return uart_state(uart)->rx_overruns;
+}
+
+/*
+ * See "uart.h"
+ */
+uint32_t uart_tx_bytes(void* uart) {
+  return uart_state(uart)->tx_bytes;
+}
+
+/*
+ * See "uart.h"
+ */
+void uart_tx_irq_enable(void* uart, uint32_t irq, int policy) {
+  struct uart* u = uart_state(uart);
+  ring_init(&u->tx_ring, u->tx_data, UART_TX_RING_SIZE);
+  u->tx_policy = policy;
+  u->tx_active = 0;
+  u->tx_dropped = 0;
+  u->tx_irq = 1;
+
+  uart_fifo_enable(u);
+  irq_enable(irq, uart_isr, u);
+}
+
+/*
+ * See "uart.h"
+ */
+uint32_t uart_tx_dropped(void* uart) {
+  return uart_state(uart)->tx_dropped;
 }
@@ -1,6 +1,8 @@
 #ifndef _UART_H_ 
 #define _UART_H_ 
 
+#include <stdint.h>
+
 /**
  * Look at the document describing the Versatile Application Board:
  *
@@ -21,6 +23,8 @@
  * Receive a byte from the given uart, this is a non-blocking call.
  * Returns 0 if there are no byte available.
  * Returns 1 if a character was read.
+ * If the uart is interrupt-driven (see uart_rx_irq_enable),
+ * the byte comes from the receive ring rather than the UART.
  */
 int uart_receive(void* uart, uint8_t *b);
 
@@ -28,9 +32,46 @@ int uart_receive(void* uart, uint8_t *b);
  * Sends a byte through the given uart, this is a blocking call.
  * The code spins until there is room in the UART TX FIFO queue 
  * to send the given byte.
+ * If the uart is interrupt-driven (see uart_tx_irq_enable),
+ * the byte is queued in the transmit ring instead, and the
+ * call only blocks, or drops the byte, if the ring is full,
+ * depending on the back-pressure policy.
  */
 void uart_send(void* uart, uint8_t b);
 
+/*
+ * Sends a byte through the given uart, if it can be done
+ * without blocking, that is, if there is room in the
+ * TX FIFO queue, or in the transmit ring if the uart is
+ * interrupt-driven.
+ * Returns 1 if the byte was sent, 0 otherwise.
+ */
+int uart_try_send(void* uart, uint8_t b);
+
+/*
+ * Waits until all the bytes sent through the given uart,
+ * including the queued ones, have been transmitted.
+ * Works with interrupts disabled.
+ */
+void uart_flush(void* uart);
+
+/*
+ * Sends len bytes through the given uart, this is a blocking
+ * call, like uart_send, but the TX FIFO is filled in bursts,
+ * looking at the UART flags once per burst rather than once
+ * per byte. If the uart is interrupt-driven, the bytes are
+ * queued in the transmit ring, all at once.
+ */
+void uart_send_buffer(void* uart, const uint8_t* buf, uint32_t len);
+
+/*
+ * Receives up to len bytes from the given uart, this is a
+ * non-blocking call, draining the RX FIFO in bursts, or the
+ * receive ring if the uart is interrupt-driven.
+ * Returns the number of bytes read, 0 if none were available.
+ */
+uint32_t uart_receive_buffer(void* uart, uint8_t* buf, uint32_t len);
+
 /*
  * This is a wrapper function, provided for simplicity,
  * it sends a C string through the given uart, assuming
@@ -38,5 +79,55 @@ void uart_send(void* uart, uint8_t b);
  */
 void uart_send_string(void* uart, const unsigned char *s);
 
+/*
+ * Switch the given uart to interrupt-driven reception.
+ * The interrupt handler drains the RX FIFO into a receive ring,
+ * and posts the reaction react(cookie) once per batch of bytes,
+ * at EVENT_PRIO_HIGH since it is user input (see event.h),
+ * the reaction must then read them all with uart_receive().
+ * If the event pool is exhausted, the bytes wait in the ring until
+ * the next batch, whose interrupt posts the reaction again.
+ * The interrupts must have been setup, see irqs_setup() in isr.h.
+ */
+void uart_rx_irq_enable(void* uart, uint32_t irq, void (*react)(void*), void* cookie);
+
+/*
+ * Returns the number of received bytes lost because
+ * the receive ring was full.
+ */
+uint32_t uart_rx_overruns(void* uart);
+
+/*
+ * Returns the number of bytes sent through the given uart, since
+ * boot, including those dropped by the UART_TX_DROP policy. It wraps
+ * around, differences are meaningful up to 4GB. uart_try_send only
+ * counts the bytes it sent.
+ */
+uint32_t uart_tx_bytes(void* uart);
+
+/*
+ * Back-pressure policies, when the transmit ring is full:
+ *   - UART_TX_BLOCK, uart_send spins until there is room
+ *   - UART_TX_DROP, uart_send drops the byte, and counts it,
+ *     see uart_tx_dropped.
+ * In both cases, uart_try_send reports a full ring.
+ */
+#define UART_TX_BLOCK 0
+#define UART_TX_DROP 1
+
+/*
+ * Switch the given uart to interrupt-driven transmission.
+ * Bytes sent are queued in a transmit ring, drained by the
+ * interrupt handler, so sending returns right away as long
+ * as there is room in the ring. The ring has one producer,
+ * sending from interrupt handlers is therefore not supported.
+ * The interrupts must have been setup, see irqs_setup() in isr.h.
+ */
+void uart_tx_irq_enable(void* uart, uint32_t irq, int policy);
+
+/*
+ * Returns the number of bytes dropped, by the UART_TX_DROP policy.
+ */
+uint32_t uart_tx_dropped(void* uart);
 
 #endif /* _UART_H_ */